@@ -1,28 +1,49 @@
-#include <cstdlib>
 #include <stdexcept>
 #include <array>
+#include <cstring>
+#include <memory>
 
 #include "CHIP-8.hpp"
+#include "addressing.hpp"
 #include "helpers.hpp"
 #include "executor.hpp"
+#include "superinstructions.hpp"
 #include "machine-specs.hpp"
 #include "font-data.hpp"
 #include "data-types.hpp"
 #include "keyboard.hpp"
+#include "compiled-program.hpp"
+#include "movie.hpp"
 
 using std::array;
-using std::rand;
 using std::out_of_range;
+using std::invalid_argument;
+using std::overflow_error;
+using std::underflow_error;
+
+static_assert(sizeof(CHIP_8) < MAX_MACHINE_SIZE, "CHIP_8 must stay compact, see its documentation");
 
 CHIP_8::CHIP_8()
-	: executor{ new Executor(*this) }
+	: recorder{ nullptr }, compiled_program{ nullptr }
 {
+	keyboard.machine = this;
 	reset();
 }
 
-CHIP_8::~CHIP_8()
+/**
+ * Called by the keyboard whenever a key's status changes.
+ */
+void CHIP_8::on_key_changed(Key k, bool is_pressed)
 {
-	delete executor;
+	if (recorder != nullptr)
+	{
+		recorder->record(is_pressed ? Movie_event_kind::KEY_PRESSED : Movie_event_kind::KEY_RELEASED, static_cast<byte>(k));
+	}
+
+	if (is_pressed)
+	{
+		resume_key_wait(k);
+	}
 }
 
 void CHIP_8::load_program(const ROM& program)
@@ -57,18 +78,180 @@ void CHIP_8::load_program_from_bytes(const array<byte, MAX_NUM_INSTRUCTIONS* INS
 	load_program(program);
 }
 
+/**
+ * Copies a program into memory starting at PROGRAM_DATA_START_LOCATION without
+ * resetting the machine first. Combined with restore_snapshot this is a much
+ * cheaper way to switch programs than load_program.
+ */
+void CHIP_8::write_program(const byte* bytes, size_t size)
+{
+	const auto max_size = size_t{ MAX_NUM_INSTRUCTIONS * INSTRUCTION_SIZE };
+	for (size_t i = 0, sz = size < max_size ? size : max_size; i < sz; ++i)
+	{
+		write_memory(PROGRAM_DATA_START_LOCATION + i, bytes[i]);
+	}
+}
+
 /**
  * Fetch and execute one instruction. Increment PC.
  *
- * Returns true if there are more instructions to execute, false otherwise.
+ * Returns true if there are more instructions to execute, false if the program
+ * has run to completion or the machine has faulted. While the machine is
+ * waiting for a key, a cycle passes without executing anything and true is
+ * returned.
  */
 bool CHIP_8::run_one()
 {
 	if (is_blocked)
 	{
-		// Machine was blocked by the previous instruction. Keep going back to that
-		// previous instruction until machine is unblocked.
-		pc -= INSTRUCTION_SIZE;
+		++cycles;
+		return true;
+	}
+
+	if (compiled_program != nullptr && !is_blocked && fault.code == Fault_code::NONE)
+	{
+		auto context = make_compiled_context();
+		const auto compiled_executed = compiled_program->run(context, 1);
+		changed_pages |= dirty_pages;
+		idiom_pages &= ~dirty_pages;
+
+		if (compiled_executed == 1)
+		{
+			++cycles;
+			return true;
+		}
+	}
+
+	return interpret_one();
+}
+
+/**
+ * Same as run_one, but faults are reported by throwing the exception that
+ * describes them.
+ */
+bool CHIP_8::run_one_or_throw()
+{
+	const auto can_run_more = run_one();
+
+	switch (fault.code)
+	{
+	case Fault_code::NONE:
+		return can_run_more;
+	case Fault_code::INVALID_INSTRUCTION:
+		throw invalid_argument("run_one: invalid instruction");
+	case Fault_code::STACK_OVERFLOW:
+		throw overflow_error("run_one: stack overflowed");
+	case Fault_code::STACK_UNDERFLOW:
+		throw underflow_error("run_one: no return address on stack");
+	case Fault_code::INVALID_KEY:
+		throw out_of_range("run_one: key does not exist");
+	}
+
+	return can_run_more;
+}
+
+/**
+ * Execute up to `max_instructions` instructions, stopping early if the program
+ * runs to completion or the machine faults. Once the machine waits for a key,
+ * the rest of the budget passes as cycles in which nothing is executed, so
+ * the timers keep running.
+ */
+Run_result CHIP_8::run(size_t max_instructions)
+{
+	size_t executed = 0;
+	while (executed < max_instructions)
+	{
+		if (is_blocked)
+		{
+			cycles += max_instructions - executed;
+			return Run_result{ executed, Run_status::WAITING_FOR_KEY };
+		}
+
+		if (compiled_program != nullptr && !is_blocked && fault.code == Fault_code::NONE)
+		{
+			auto context = make_compiled_context();
+			const auto compiled_executed = compiled_program->run(context, max_instructions - executed);
+			changed_pages |= dirty_pages;
+			idiom_pages &= ~dirty_pages;
+
+			executed += compiled_executed;
+			cycles += compiled_executed;
+
+			if (executed == max_instructions)
+			{
+				break;
+			}
+		}
+
+		executed += skip_idle_loop(max_instructions - executed);
+		if (executed == max_instructions)
+		{
+			break;
+		}
+
+		if (const auto fused = Superinstructions{ *this }.run(max_instructions - executed); fused > 0)
+		{
+			executed += fused;
+			continue;
+		}
+
+		// Translated code stopped at an instruction it can't handle (or there
+		// is no translated code). Let the interpreter take this one.
+		if (!interpret_one())
+		{
+			const auto status = fault.code == Fault_code::NONE ? Run_status::FINISHED : Run_status::FAULTED;
+			return Run_result{ executed, status };
+		}
+		++executed;
+	}
+
+	return Run_result{ executed, Run_status::RUNNING };
+}
+
+/**
+ * Run the machine without a host for `num_frames` refreshes of
+ * INSTRUCTIONS_PER_REFRESH cycles each. Idle loops are skipped over, and so is
+ * waiting for a key, since nobody can press one.
+ */
+Run_result CHIP_8::run_frames(size_t num_frames)
+{
+	return run(num_frames * INSTRUCTIONS_PER_REFRESH);
+}
+
+const Fault& CHIP_8::get_fault() const
+{
+	return fault;
+}
+
+bool CHIP_8::is_waiting_for_key() const
+{
+	return is_blocked;
+}
+
+/**
+ * Restarts the sequence of numbers Cxkk draws from. Machines with the same
+ * seed and the same input behave identically.
+ */
+void CHIP_8::seed_random(std::uint32_t seed)
+{
+	random_state = seed != 0 ? seed : DEFAULT_RANDOM_SEED;
+}
+
+void CHIP_8::set_compiled_program(const Compiled_program* program)
+{
+	compiled_program = program;
+}
+
+bool CHIP_8::interpret_one()
+{
+	if (fault.code != Fault_code::NONE)
+	{
+		return false;
+	}
+
+	if (is_blocked)
+	{
+		return true;
 	}
 
 	const auto ins = get_current_instruction();
@@ -81,24 +264,330 @@ bool CHIP_8::run_one()
 		return false;
 	}
 
+	const auto ins_pc = pc;
 	pc += INSTRUCTION_SIZE;
 
-	executor->execute(ins);
+	Executor{ *this }.execute(ins);
+
+	if (fault.code != Fault_code::NONE)
+	{
+		// Executor raises faults before touching any state, so the machine
+		// halts right at the faulting instruction.
+		fault.pc = ins_pc;
+		fault.instruction = ins.raw_instruction;
+		pc = ins_pc;
+		return false;
+	}
+
+	++cycles;
 	return true;
 }
 
+/**
+ * Called by Executor when an instruction can't be executed. The rest of the
+ * fault is filled in by interpret_one.
+ */
+void CHIP_8::raise_fault(Fault_code code)
+{
+	fault.code = code;
+}
+
+/**
+ * Called by the keyboard whenever a key is pressed. Completes the Fx0A the
+ * machine is waiting on, if any.
+ */
+void CHIP_8::resume_key_wait(Key k)
+{
+	if (!is_blocked || k > Key::KF)
+	{
+		return;
+	}
+
+	registers[key_wait_register] = static_cast<byte>(k);
+	is_blocked = false;
+}
+
+/**
+ * Many programs wait for the delay timer with a loop like
+ *
+ *     A:     Fx07      ; Vx = delay timer
+ *     A + 2: 3x00      ; skip the jump once the timer has run out
+ *     A + 4: 1A        ; jump back to A
+ *
+ * or simply jump to themselves. Until the delay timer runs out, an iteration
+ * changes nothing but Vx, whose value at any cycle follows from the timer.
+ *
+ * If pc is at the jump of such a loop, this fast-forwards through as many
+ * whole iterations as fit in `budget` and end before the timer runs out, and
+ * returns the number of instructions skipped. Cycle accounting is the same as
+ * if they had been executed.
+ */
+size_t CHIP_8::skip_idle_loop(size_t budget)
+{
+	if (is_blocked || fault.code != Fault_code::NONE)
+	{
+		return 0;
+	}
+
+	if (is_jump_to_self())
+	{
+		// Where the jump lands, should pc have run past the end of memory.
+		pc = wrap_address(pc);
+		cycles += budget;
+		return budget;
+	}
+
+	double_byte loop_start = 0;
+	byte x = 0;
+	if (!find_timer_wait_loop(loop_start, x) || pc != loop_start + 2 * INSTRUCTION_SIZE)
+	{
+		return 0;
+	}
+
+	// Each iteration is the jump, then Fx07 one cycle later, then the skip. The
+	// iterations whose Fx07 still reads a non-zero timer loop back around.
+	const auto deadline = delay_timer.deadline;
+	const auto spinning = deadline > cycles + 1 ? (deadline - cycles + 1) / 3 : 0;
+	const auto iterations = spinning < budget / 3 ? spinning : budget / 3;
+	if (iterations == 0)
+	{
+		return 0;
+	}
+
+	const auto skipped = 3 * iterations;
+	registers[x] = delay_timer.value_at(cycles + skipped - 2);
+	cycles += skipped;
+	return skipped;
+}
+
+bool CHIP_8::is_jump_to_self() const
+{
+	const auto ins = concatenate_bytes(read_memory(pc), read_memory(pc + 1));
+	return ins == (0x1000 | wrap_address(pc));
+}
+
+/**
+ * Checks whether pc is on one of the three instructions of a delay timer wait
+ * loop (see skip_idle_loop). If so, returns the address of the loop's first
+ * instruction and the register it loads the timer into.
+ */
+bool CHIP_8::find_timer_wait_loop(double_byte& loop_start, byte& x) const
+{
+	for (int offset = 0; offset <= 2 * INSTRUCTION_SIZE; offset += INSTRUCTION_SIZE)
+	{
+		const auto start = wrap_address(pc - offset);
+		const auto reg = read_memory(start) & 0xF;
+		const auto jump_back = concatenate_bytes(read_memory(start + 4), read_memory(start + 5));
+		if (read_memory(start) == (0xF0 | reg) && read_memory(start + 1) == 0x07
+			&& read_memory(start + 2) == (0x30 | reg) && read_memory(start + 3) == 0x00
+			&& jump_back == (0x1000 | start))
+		{
+			loop_start = start;
+			x = static_cast<byte>(reg);
+			return true;
+		}
+	}
+
+	return false;
+}
+
 void CHIP_8::load_state(const Machine_state& state)
 {
-	memory = state.memory;
+	// States loaded by the debugger usually differ from the current one in a
+	// few bytes at most, so only report the pages which actually change.
+	for (size_t page = 0; page < NUM_PAGES; ++page)
+	{
+		const auto offset = page * PAGE_SIZE;
+		if (std::memcmp(memory.data() + offset, state.memory.data() + offset, PAGE_SIZE) != 0)
+		{
+			std::memcpy(memory.data() + offset, state.memory.data() + offset, PAGE_SIZE);
+			changed_pages |= std::uint64_t{ 1 } << page;
+			idiom_pages &= ~(std::uint64_t{ 1 } << page);
+		}
+	}
+
+	load_processor_state(state);
+
+	base_memory = nullptr;
+	dirty_pages = ~std::uint64_t{ 0 };
+}
+
+void CHIP_8::load_processor_state(const Processor_state& state)
+{
 	registers = state.registers;
 	stack = state.stack;
 	frame_buffer = state.frame_buffer;
 	pc = state.pc;
 	index_register = state.index_register;
 	stack_pointer = state.stack_pointer;
-	delay_timer = state.delay_timer;
-	sound_timer = state.sound_timer;
+	delay_timer.set(state.cycles, state.delay_timer);
+	sound_timer.set(state.cycles, state.sound_timer);
 	is_blocked = state.is_blocked;
+	key_wait_register = state.key_wait_register;
+	fault = state.fault;
+	cycles = state.cycles;
+	random_state = state.random_state;
+}
+
+CHIP_8::Snapshot CHIP_8::take_snapshot()
+{
+	if (base_memory == nullptr || dirty_pages != 0)
+	{
+		// Pages written since the last snapshot get fresh copies. The rest are
+		// shared with the previous image. An image or page which nothing but
+		// the machine holds any more is updated in place instead, so that a
+		// snapshot taken and dropped every frame doesn't allocate. Images and
+		// pages are only ever created non-const, which makes that legal.
+		const auto is_new = base_memory == nullptr;
+		if (is_new || base_memory.use_count() > 1)
+		{
+			base_memory = std::make_shared<Memory_image>(is_new ? Memory_image{} : *base_memory);
+		}
+
+		auto& image = const_cast<Memory_image&>(*base_memory);
+		for (size_t page = 0; page < NUM_PAGES; ++page)
+		{
+			if (!is_new && !(dirty_pages >> page & 1))
+			{
+				continue;
+			}
+
+			if (image[page] == nullptr || image[page].use_count() > 1)
+			{
+				image[page] = std::make_shared<Memory_page>();
+			}
+			std::memcpy(const_cast<Memory_page&>(*image[page]).data(), memory.data() + page * PAGE_SIZE, PAGE_SIZE);
+		}
+
+		changed_pages |= dirty_pages;
+		dirty_pages = 0;
+	}
+
+	Snapshot snapshot;
+	snapshot.memory = base_memory;
+	snapshot.frame_buffer = frame_buffer;
+	snapshot.registers = registers;
+	snapshot.stack = stack;
+	snapshot.pc = pc;
+	snapshot.index_register = index_register;
+	snapshot.stack_pointer = stack_pointer;
+	snapshot.delay_timer = delay_timer;
+	snapshot.sound_timer = sound_timer;
+	snapshot.is_blocked = is_blocked;
+	snapshot.key_wait_register = key_wait_register;
+	snapshot.fault = fault;
+	snapshot.cycles = cycles;
+	snapshot.random_state = random_state;
+
+	return snapshot;
+}
+
+void CHIP_8::restore_snapshot(const Snapshot& snapshot)
+{
+	const auto& image = *snapshot.memory;
+	for (size_t page = 0; page < NUM_PAGES; ++page)
+	{
+		const auto is_clean = base_memory != nullptr && !(dirty_pages >> page & 1) && (*base_memory)[page] == image[page];
+		if (!is_clean)
+		{
+			std::memcpy(memory.data() + page * PAGE_SIZE, image[page]->data(), PAGE_SIZE);
+			changed_pages |= std::uint64_t{ 1 } << page;
+			idiom_pages &= ~(std::uint64_t{ 1 } << page);
+		}
+	}
+
+	base_memory = snapshot.memory;
+	dirty_pages = 0;
+
+	frame_buffer = snapshot.frame_buffer;
+
+	registers = snapshot.registers;
+	stack = snapshot.stack;
+	pc = snapshot.pc;
+	index_register = snapshot.index_register;
+	stack_pointer = snapshot.stack_pointer;
+	delay_timer = snapshot.delay_timer;
+	sound_timer = snapshot.sound_timer;
+	is_blocked = snapshot.is_blocked;
+	key_wait_register = snapshot.key_wait_register;
+	fault = snapshot.fault;
+	cycles = snapshot.cycles;
+	random_state = snapshot.random_state;
+}
+
+Machine_state CHIP_8::get_state() const
+{
+	return Machine_state{ get_processor_state(), memory };
+}
+
+Processor_state CHIP_8::get_processor_state() const
+{
+	return Processor_state{
+		registers,
+		stack,
+		frame_buffer,
+		pc,
+		index_register,
+		stack_pointer,
+		get_delay_timer(),
+		get_sound_timer(),
+		is_blocked,
+		key_wait_register,
+		fault,
+		cycles,
+		random_state,
+	};
+}
+
+double_byte CHIP_8::get_pc() const
+{
+	return pc;
+}
+
+const array<byte, NUM_REGISTERS>& CHIP_8::get_registers() const
+{
+	return registers;
+}
+
+std::uint64_t CHIP_8::get_cycle_count() const
+{
+	return cycles;
+}
+
+byte CHIP_8::get_delay_timer() const
+{
+	return delay_timer.value_at(cycles);
+}
+
+byte CHIP_8::get_sound_timer() const
+{
+	return sound_timer.value_at(cycles);
+}
+
+static bool is_key_pressed_callback(void* machine, byte key)
+{
+	return static_cast<CHIP_8*>(machine)->keyboard.is_key_pressed(static_cast<Key>(key));
+}
+
+Compiled_context CHIP_8::make_compiled_context()
+{
+	return Compiled_context
+	{
+		memory.data(),
+		registers.data(),
+		stack.data(),
+		&frame_buffer,
+		&pc,
+		&index_register,
+		&stack_pointer,
+		&delay_timer,
+		&sound_timer,
+		cycles,
+		&dirty_pages,
+		this,
+		is_key_pressed_callback,
+		[](void* machine) { return random_byte(static_cast<CHIP_8*>(machine)->random_state); },
+	};
 }
 
 void
@@ -118,25 +607,39 @@ CHIP_8::load_fonts(double_byte start_loc, const decltype(FONT_DATA)& fonts)
 	}
 }
 
+/**
+ * Returns the instruction at pc. An instruction in the last byte of memory
+ * continues at its start.
+ */
 Instruction CHIP_8::get_current_instruction() const
 {
 	// A CHIP-8 insturction is 2 bytes long; hence `pc + 1`.
-	if (pc + 1 >= memory.size())
-	{
-		throw out_of_range("get_current_instruction: pc points outside memory");
-	}
-
-	const instruction_t ins = concatenate_bytes(memory.at(pc), memory.at(pc + 1));
+	const instruction_t ins = concatenate_bytes(read_memory(pc), read_memory(pc + 1));
 	return Helper::make_instruction_from_bytes(ins);
 }
 
 void CHIP_8::reset()
 {
 	pc = PROGRAM_DATA_START_LOCATION;
+	index_register = 0;
+	stack_pointer = 0;
+	delay_timer = Timer{ 0 };
+	sound_timer = Timer{ 0 };
+	is_blocked = false;
+	key_wait_register = 0;
+	fault = Fault{ Fault_code::NONE, 0, 0 };
+	cycles = 0;
+	random_state = DEFAULT_RANDOM_SEED;
+
+	base_memory = nullptr;
+	dirty_pages = ~std::uint64_t{ 0 };
+	changed_pages = ~std::uint64_t{ 0 };
+	idiom_pages = 0;
+
 	memory.fill(0);
 	registers.fill(0);
 	stack.fill(0);
-	frame_buffer.fill({});
+	frame_buffer.clear();
 
 	for (auto key = Key::K0; key <= Key::KF; key = static_cast<Key>(static_cast<int>(key) + 1))
 	{
@@ -151,18 +654,12 @@ const Frame_buffer& CHIP_8::get_frame_buffer() const
 	return frame_buffer;
 }
 
-void CHIP_8::decrement_timers(byte times)
-{
-	delay_timer = times >= delay_timer ? 0 : (delay_timer - times);
-	sound_timer = times >= sound_timer ? 0 : (sound_timer - times);
-}
-
 void CHIP_8::Helper::insert_instruction(CHIP_8& machine, instruction_t ins, double_byte location)
 {
 	for (size_t byte_i = 0; byte_i < INSTRUCTION_SIZE; ++byte_i)
 	{
 		const auto start_nibble = byte_i * NIBBLES_PER_BYTE;
-		machine.memory[location + byte_i] = get_nibbles_in_range(
+		machine.memory[wrap_address(location + byte_i)] = get_nibbles_in_range(
 			ins,
 			start_nibble,
 			start_nibble + NIBBLES_PER_BYTE - 1
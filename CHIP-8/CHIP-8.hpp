@@ -1,31 +1,105 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 
 #include "data-types.hpp"
+#include "addressing.hpp"
 #include "font-data.hpp"
 #include "machine-specs.hpp"
 #include "keyboard.hpp"
 
 class Executor;
 class Debugger;
-
+class Translator;
+class Compiled_program;
+class Movie_recorder;
+class Superinstructions;
+class Frame_publisher;
+class Run_ahead;
+struct Compiled_context;
+
+/**
+ * A complete machine in a single object of under 4800 bytes (see MAX_MACHINE_SIZE),
+ * most of it memory. Constructing and destroying one never allocates, so
+ * machines can be packed by the hundred thousand into arrays.
+ */
 class CHIP_8
 {
 public:
+	/**
+	 * A copy-on-write copy of the machine's state, which can be restored into
+	 * any machine. Memory is shared with the machine (and other snapshots)
+	 * until someone writes to it, so taking a snapshot costs little more than
+	 * copying the registers, stack and the 256 byte frame buffer.
+	 *
+	 * Restoring only copies the memory pages which differ from the snapshot,
+	 * which makes forking many machines off a common ancestor cheap.
+	 */
+	class Snapshot
+	{
+	private:
+		std::shared_ptr<const Memory_image> memory;
+		Frame_buffer frame_buffer;
+
+		std::array<byte, NUM_REGISTERS> registers;
+		std::array<double_byte, STACK_SIZE / STACK_ENTRY_SIZE> stack;
+
+		double_byte pc;
+		double_byte index_register;
+		byte stack_pointer;
+
+		Timer delay_timer;
+		Timer sound_timer;
+
+		bool is_blocked;
+		byte key_wait_register;
+
+		Fault fault;
+
+		std::uint64_t cycles;
+		std::uint32_t random_state;
+
+		friend class CHIP_8;
+	};
+
 	void load_program(const ROM& program);
 	void load_program_from_bytes(const std::array<byte, MAX_NUM_INSTRUCTIONS* INSTRUCTION_SIZE>& bytes);
+	void write_program(const byte* bytes, size_t size);
 	bool run_one();
+	bool run_one_or_throw();
+	Run_result run(size_t max_instructions);
+	Run_result run_frames(size_t num_frames);
+
+	const Fault& get_fault() const;
+	void seed_random(std::uint32_t seed);
+	bool is_waiting_for_key() const;
+
+	void set_compiled_program(const Compiled_program* program);
 
 	void load_state(const Machine_state& state);
 
+	Snapshot take_snapshot();
+	void restore_snapshot(const Snapshot& snapshot);
+
+	double_byte get_pc() const;
+	const std::array<byte, NUM_REGISTERS>& get_registers() const;
+	Instruction get_current_instruction() const;
+	std::uint64_t get_cycle_count() const;
+	byte get_delay_timer() const;
+	byte get_sound_timer() const;
+
 	const Frame_buffer& get_frame_buffer() const;
-	void decrement_timers(byte times);
 
 	Keyboard keyboard;
 
 	CHIP_8();
-	~CHIP_8();
+
+	// The keyboard's hook refers back to the machine that owns it.
+	CHIP_8(const CHIP_8&) = delete;
+	CHIP_8& operator=(const CHIP_8&) = delete;
 private:
 	std::array<byte, MEMORY_SIZE> memory;
 	std::array<byte, NUM_REGISTERS> registers;
@@ -37,19 +111,85 @@ private:
 	double_byte index_register;
 	byte stack_pointer;
 
-	byte delay_timer;
-	byte sound_timer;
+	// Both run on `cycles`, so hosts never have to count them down.
+	Timer delay_timer;
+	Timer sound_timer;
 
+	// Set while Fx0A waits for a key. Nothing runs until the keyboard reports
+	// a press, which stores the key in `key_wait_register`.
 	bool is_blocked;
+	byte key_wait_register;
+
+	Fault fault;
+
+	// Time since the program was loaded: one cycle per instruction executed,
+	// and one per instruction's worth of time spent waiting for a key.
+	std::uint64_t cycles;
+
+	// State of the generator behind Cxkk. Part of the machine so that runs can
+	// be reproduced.
+	std::uint32_t random_state;
+
+	// Notified of every input from the host while recording.
+	Movie_recorder* recorder;
+
+	// The image memory was last synchronised with by a snapshot, and the pages
+	// written since. Pages of a null image are always considered dirty.
+	std::shared_ptr<const Memory_image> base_memory;
+	std::uint64_t dirty_pages;
+
+	// Pages written since the Debugger last collected memory changes.
+	// Translated code only marks dirty_pages, which are folded into these
+	// after it returns.
+	std::uint64_t changed_pages;
+
+	// Where the idioms Superinstructions runs start: bit i of
+	// `idiom_starts[page]` is set if one starts at byte 2i of the page. Only
+	// valid for the pages in `idiom_pages`, which writes remove pages from.
+	std::array<std::uint32_t, NUM_PAGES> idiom_starts;
+	std::uint64_t idiom_pages;
+
+	byte read_memory(size_t address) const
+	{
+		return memory[wrap_address(address)];
+	}
+
+	void write_memory(size_t address, byte value)
+	{
+		const auto location = wrap_address(address);
+		memory[location] = value;
+
+		const auto page_bit = std::uint64_t{ 1 } << (location / PAGE_SIZE);
+		dirty_pages |= page_bit;
+		changed_pages |= page_bit;
+		idiom_pages &= ~page_bit;
+	}
+
+	Machine_state get_state() const;
+	Processor_state get_processor_state() const;
+	void load_processor_state(const Processor_state& state);
 
 	void load_fonts(double_byte start_location, const decltype(FONT_DATA)& font_data);
-	Instruction get_current_instruction() const;
 	void reset();
+	bool interpret_one();
+	size_t skip_idle_loop(size_t budget);
+	bool is_jump_to_self() const;
+	bool find_timer_wait_loop(double_byte& loop_start, byte& x) const;
+	void raise_fault(Fault_code code);
+	void resume_key_wait(Key k);
+	void on_key_changed(Key k, bool is_pressed);
+	Compiled_context make_compiled_context();
 
-	Executor* executor;
+	const Compiled_program* compiled_program;
 
 	friend class Executor;
+	friend class Superinstructions;
+	friend class Keyboard;
 	friend class Debugger;
+	friend class Translator;
+	friend class Movie_recorder;
+	friend class Frame_publisher;
+	friend class Run_ahead;
 
 	class Helper
 	{
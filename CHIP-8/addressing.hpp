@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+
+#include "machine-specs.hpp"
+#include "data-types.hpp"
+
+/**
+ * Returns the memory location `address` refers to. CHIP-8 addresses are 12 bits
+ * wide, so, as on the original hardware, anything past the end of memory wraps
+ * around to its start. Registers which hold addresses (pc and I) keep all of
+ * their bits; only memory accesses are wrapped.
+ *
+ * Building with CHIP8_REPORT_ADDRESS_WRAPS defined prints every access which
+ * wraps, which is almost always a bug in the program being run.
+ */
+inline double_byte wrap_address(std::size_t address)
+{
+#ifdef CHIP8_REPORT_ADDRESS_WRAPS
+	if (address > ADDRESS_MASK)
+	{
+		std::fprintf(stderr, "CHIP-8: address 0x%zX wrapped to 0x%03zX\n", address, address & ADDRESS_MASK);
+	}
+#endif
+
+	return static_cast<double_byte>(address & ADDRESS_MASK);
+}
\ No newline at end of file
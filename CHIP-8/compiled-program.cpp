@@ -0,0 +1,69 @@
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include "compiled-program.hpp"
+
+using std::runtime_error;
+using std::string;
+
+static void* open_library(const string& path)
+{
+#ifdef _WIN32
+	return LoadLibraryA(path.c_str());
+#else
+	return dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
+}
+
+static void* find_symbol(void* library, const char* name)
+{
+#ifdef _WIN32
+	return reinterpret_cast<void*>(GetProcAddress(static_cast<HMODULE>(library), name));
+#else
+	return dlsym(library, name);
+#endif
+}
+
+static void close_library(void* library)
+{
+#ifdef _WIN32
+	FreeLibrary(static_cast<HMODULE>(library));
+#else
+	dlclose(library);
+#endif
+}
+
+Compiled_program::Compiled_program(const string& library_path)
+	: library{ open_library(library_path) }, run_function{ nullptr }
+{
+	if (library == nullptr)
+	{
+		throw runtime_error("Compiled_program: cannot load " + library_path);
+	}
+
+	using Version_function = int (*)();
+	const auto version = reinterpret_cast<Version_function>(find_symbol(library, COMPILED_ABI_VERSION_SYMBOL));
+	run_function = reinterpret_cast<Compiled_run_function>(find_symbol(library, COMPILED_RUN_SYMBOL));
+
+	if (version == nullptr || run_function == nullptr || version() != COMPILED_ABI_VERSION)
+	{
+		close_library(library);
+		throw runtime_error("Compiled_program: " + library_path + " is not a compatible translated ROM");
+	}
+}
+
+Compiled_program::~Compiled_program()
+{
+	close_library(library);
+}
+
+std::size_t Compiled_program::run(Compiled_context& context, std::size_t budget) const
+{
+	return run_function(context, budget);
+}
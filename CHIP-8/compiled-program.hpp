@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "data-types.hpp"
+
+/**
+ * The interface between a CHIP_8 and the native code emitted by Translator.
+ *
+ * Translated code never sees a CHIP_8 directly. Instead, the machine hands it
+ * pointers to its state and a couple of callbacks for the operations which
+ * depend on the host (keyboard and random numbers).
+ */
+struct Compiled_context
+{
+	byte* memory;
+	byte* registers;
+	double_byte* stack;
+	Frame_buffer* frame_buffer;
+
+	double_byte* pc;
+	double_byte* index_register;
+	byte* stack_pointer;
+
+	Timer* delay_timer;
+	Timer* sound_timer;
+
+	// The cycle the run starts at. Instruction n of the run happens at cycle
+	// `cycles + n`.
+	std::uint64_t cycles;
+
+	// Translated code must mark the pages it writes, see CHIP_8::take_snapshot.
+	std::uint64_t* dirty_pages;
+
+	void* machine;
+	bool (*is_key_pressed)(void* machine, byte key);
+	byte (*random_byte)(void* machine);
+};
+
+/**
+ * Runs at most `budget` instructions starting at `*context.pc`, and returns the
+ * number of instructions executed. Translated code returns early, leaving pc at
+ * the instruction it could not handle, when that instruction has to be handled
+ * by the interpreter.
+ */
+using Compiled_run_function = std::size_t (*)(Compiled_context& context, std::size_t budget);
+
+constexpr auto COMPILED_ABI_VERSION = 5;
+constexpr auto COMPILED_ABI_VERSION_SYMBOL = "chip8_compiled_abi_version";
+constexpr auto COMPILED_RUN_SYMBOL = "chip8_run_compiled";
+
+/**
+ * A shared library produced by compiling the output of Translator.
+ */
+class Compiled_program
+{
+public:
+	explicit Compiled_program(const std::string& library_path);
+	~Compiled_program();
+
+	Compiled_program(const Compiled_program&) = delete;
+	Compiled_program& operator=(const Compiled_program&) = delete;
+
+	std::size_t run(Compiled_context& context, std::size_t budget) const;
+private:
+	void* library;
+	Compiled_run_function run_function;
+};
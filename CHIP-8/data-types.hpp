@@ -1,7 +1,10 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
 #include <array>
+#include <memory>
+#include <bit>
 
 #include "machine-specs.hpp"
 
@@ -9,7 +12,76 @@ using byte = std::uint8_t;
 using double_byte = std::uint16_t;
 using instruction_t = double_byte;
 
-using Frame_buffer = std::array<std::array<byte, FRAME_BUFFER_HEIGHT>, FRAME_BUFFER_WIDTH>;
+/**
+ * The screen, one bit per pixel: bit x of `rows[y]` is the pixel in column x of
+ * row y.
+ */
+struct Frame_buffer
+{
+	static_assert(FRAME_BUFFER_WIDTH == 64, "a row must fill a std::uint64_t exactly");
+
+	std::array<std::uint64_t, FRAME_BUFFER_HEIGHT> rows;
+
+	bool get_pixel(std::size_t x, std::size_t y) const
+	{
+		return (rows[y] >> x) & 1;
+	}
+
+	void clear()
+	{
+		rows.fill(0);
+	}
+
+	/**
+	 * XORs a row of a sprite onto the screen with its leftmost pixel at (x, y),
+	 * wrapping around the edges. Returns whether any pixel was turned off.
+	 */
+	bool draw_sprite_row(std::size_t x, std::size_t y, byte bits)
+	{
+		// Sprites store their leftmost pixel in the most significant bit.
+		std::uint64_t pattern = 0;
+		for (std::size_t j = 0; j < BITS_PER_BYTE; ++j)
+		{
+			pattern |= std::uint64_t{ (bits >> (BITS_PER_BYTE - j - 1)) & 1u } << j;
+		}
+		pattern = std::rotl(pattern, static_cast<int>(x % FRAME_BUFFER_WIDTH));
+
+		auto& row = rows[y % FRAME_BUFFER_HEIGHT];
+		const bool collided = (row & pattern) != 0;
+		row ^= pattern;
+
+		return collided;
+	}
+
+	bool operator==(const Frame_buffer& other) const = default;
+};
+
+/**
+ * The delay or sound timer, stored as the cycle it runs out at rather than as
+ * its value. Timers count down on every multiple of CYCLES_PER_TIMER_TICK, so
+ * the value at any cycle follows from the deadline and nobody has to count it
+ * down.
+ */
+struct Timer
+{
+	std::uint64_t deadline;
+
+	byte value_at(std::uint64_t cycle) const
+	{
+		if (deadline <= cycle)
+		{
+			return 0;
+		}
+
+		return static_cast<byte>(deadline / CYCLES_PER_TIMER_TICK - cycle / CYCLES_PER_TIMER_TICK);
+	}
+
+	void set(std::uint64_t cycle, byte value)
+	{
+		deadline = (cycle / CYCLES_PER_TIMER_TICK + value) * CYCLES_PER_TIMER_TICK;
+	}
+};
+
 using ROM = std::array<instruction_t, MAX_NUM_INSTRUCTIONS>;
 
 /**
@@ -42,9 +114,131 @@ struct Instruction
 	Instruction_payload payload;
 };
 
-struct Machine_state
+/**
+ * Reasons for which a machine can stop executing a program before it has run
+ * to completion. A faulted machine stays halted at the faulting instruction
+ * until a new program or state is loaded.
+ */
+enum class Fault_code
+{
+	NONE,
+	INVALID_INSTRUCTION,
+	STACK_OVERFLOW,
+	STACK_UNDERFLOW,
+	INVALID_KEY,
+};
+
+struct Fault
+{
+	Fault_code code;
+	double_byte pc;
+	instruction_t instruction;
+
+	bool operator==(const Fault& other) const = default;
+};
+
+enum class Run_status
+{
+	RUNNING, FINISHED, FAULTED, WAITING_FOR_KEY
+};
+
+struct Run_result
+{
+	std::size_t instructions_executed;
+	Run_status status;
+};
+
+/**
+ * Everything that happened during a call to Debugger::run_frames. Bit `c` of
+ * `categories` is set if at least one instruction of category `c` ran.
+ */
+struct Frame_report
+{
+	std::size_t instructions_executed;
+	Run_status status;
+	std::uint16_t categories;
+};
+
+struct Memory_change
+{
+	double_byte address;
+	byte old_value;
+	byte new_value;
+};
+
+/**
+ * A change to one of the general purpose registers, or to the index register
+ * when `id` is NUM_REGISTERS.
+ */
+struct Register_change
+{
+	byte id;
+	double_byte old_value;
+	double_byte new_value;
+};
+
+enum class Debug_event_kind : byte
+{
+	FRAME_CHANGED, MEMORY_WRITE, REGISTER_WRITE, CALL, RETURN, KEY_WAIT
+};
+
+/**
+ * Something an instruction run by the Debugger did. What `address` and
+ * `length` mean depends on the kind:
+ *
+ * - MEMORY_WRITE: `length` bytes were written starting at `address`.
+ * - REGISTER_WRITE: bit i of `registers` is set if Vi was written, and bit
+ *   NUM_REGISTERS if the index register was.
+ * - CALL: `address` is the subroutine called.
+ * - RETURN: `address` is where the subroutine returned to.
+ * - KEY_WAIT: `address` is the register the key will be stored in.
+ */
+struct Debug_event
+{
+	Debug_event_kind kind;
+	std::uint64_t cycle;
+	double_byte pc;
+	instruction_t instruction;
+
+	double_byte address;
+	double_byte length;
+	std::uint32_t registers;
+};
+
+constexpr std::uint32_t ALL_REGISTERS = (1u << (NUM_REGISTERS + 1)) - 1;
+
+/**
+ * The events a Debugger subscriber wants to hear about: bit k of `kinds` for
+ * Debug_event_kind k. Memory writes only count if they touch
+ * [memory_start, memory_end), and register writes only if they touch one of
+ * `registers`.
+ *
+ * Batched subscribers get the events of a whole refresh of
+ * Debugger::run_frames in one call at its end. Others get the events of every
+ * instruction as soon as it has run.
+ */
+struct Debug_filter
+{
+	std::uint8_t kinds;
+	double_byte memory_start;
+	double_byte memory_end;
+	std::uint32_t registers;
+	bool batched;
+};
+
+/**
+ * Memory split into pages which can be shared between snapshots and machines.
+ * Shared pages are never written to; a machine copies a page into its own
+ * memory before writing it.
+ */
+using Memory_page = std::array<byte, PAGE_SIZE>;
+using Memory_image = std::array<std::shared_ptr<const Memory_page>, NUM_PAGES>;
+
+/**
+ * Everything about a machine but its memory.
+ */
+struct Processor_state
 {
-	std::array<byte, MEMORY_SIZE> memory;
 	std::array<byte, NUM_REGISTERS> registers;
 	std::array<double_byte, STACK_SIZE / STACK_ENTRY_SIZE> stack;
 
@@ -58,6 +252,21 @@ struct Machine_state
 	byte sound_timer;
 
 	bool is_blocked;
+	byte key_wait_register;
+
+	Fault fault;
+
+	std::uint64_t cycles;
+	std::uint32_t random_state;
+
+	bool operator==(const Processor_state& other) const = default;
+};
+
+struct Machine_state : Processor_state
+{
+	std::array<byte, MEMORY_SIZE> memory;
+
+	bool operator==(const Machine_state& other) const = default;
 };
 
 enum class Execution_event
@@ -1,17 +1,28 @@
 #include <array>
+#include <cstring>
 
 #include "CHIP-8.hpp"
 #include "debugger.hpp"
+#include "addressing.hpp"
 #include "data-types.hpp"
 #include "machine-specs.hpp"
 
-Debugger::Debugger(CHIP_8& machine)
-	: machine{ machine }
+Debugger::Debugger(CHIP_8& machine, size_t history_size)
+	: machine{ machine }, steps{ history_size }, memory_baseline{ machine.memory }, registers_baseline{ machine.registers },
+	index_register_baseline{ machine.index_register }
 {
+	machine.changed_pages = 0;
 }
 
 bool Debugger::run_one()
 {
+	// Nothing to report while the machine is waiting for a key, but the cycle
+	// still passes, so the timers keep running.
+	if (machine.is_waiting_for_key())
+	{
+		return machine.run_one();
+	}
+
 	const auto& executed_instruction = machine.get_current_instruction();
 	const auto can_run_more = run_one_without_callback();
 
@@ -20,6 +31,9 @@ bool Debugger::run_one()
 		f(Execution_event::RUN_ONE, executed_instruction);
 	}
 
+	// A single step is a batch of its own.
+	deliver_events(true);
+
 	return can_run_more;
 }
 
@@ -38,31 +52,124 @@ bool Debugger::go_back_one()
 
 bool Debugger::run_one_without_callback()
 {
-	const auto current_state = Machine_state{
-		machine.memory,
-		machine.registers,
-		machine.stack,
-		machine.frame_buffer,
-		machine.pc,
-		machine.index_register,
-		machine.stack_pointer,
-		machine.delay_timer,
-		machine.sound_timer,
-		machine.is_blocked,
-	};
-	states.push(current_state);
+	// Cycles spent waiting for a key aren't kept to go back over.
+	if (machine.is_waiting_for_key())
+	{
+		return machine.run_one();
+	}
+
+	const auto ins = machine.get_current_instruction();
+
+	auto& step = steps.push();
+	step.state = machine.get_processor_state();
+	step.num_pages = 0;
+
+	// The pages at both ends of what the instruction writes, which may wrap
+	// around the end of memory.
+	if (const auto length = Helper::get_memory_written(ins); length != 0)
+	{
+		const auto first = wrap_address(machine.index_register);
+		for (const auto address : { first, wrap_address(first + length - 1) })
+		{
+			const auto page = static_cast<byte>(address / PAGE_SIZE);
+			if (step.num_pages == 0 || step.page_numbers[0] != page)
+			{
+				std::memcpy(step.pages[step.num_pages].data(), machine.memory.data() + page * PAGE_SIZE, PAGE_SIZE);
+				step.page_numbers[step.num_pages++] = page;
+			}
+		}
+	}
+
+	if (subscriptions.empty())
+	{
+		return machine.run_one();
+	}
+
+	const auto can_run_more = machine.run_one();
+	collect_events(ins, step.state);
 
-	return machine.run_one();
+	return can_run_more;
 }
 
 bool Debugger::go_back_one_without_callback()
 {
-	const auto& most_recent_state = states.top();
-	states.pop();
+	if (steps.empty())
+	{
+		return false;
+	}
 
-	machine.load_state(most_recent_state);
+	const auto& step = steps.top();
+	machine.load_processor_state(step.state);
+	for (size_t i = 0; i < step.num_pages; ++i)
+	{
+		const auto start = step.page_numbers[i] * PAGE_SIZE;
+		for (size_t j = 0; j < PAGE_SIZE; ++j)
+		{
+			machine.write_memory(start + j, step.pages[i][j]);
+		}
+	}
+	steps.pop();
 
-	return !states.empty();
+	return !steps.empty();
+}
+
+/**
+ * Runs `num_frames` refreshes like CHIP_8::run_frames, but one instruction at a
+ * time so that every instruction can be gone back over. Instead of an event per
+ * instruction, the callbacks registered with on_frame are called once at the
+ * end with a summary of the whole run, and batched subscribers once at the end
+ * of every refresh.
+ */
+Frame_report Debugger::run_frames(size_t num_frames)
+{
+	auto report = Frame_report{ 0, Run_status::RUNNING, 0 };
+	bool can_run_more = true;
+	for (size_t frame = 0; can_run_more && frame < num_frames; ++frame)
+	{
+		for (size_t i = 0; i < INSTRUCTIONS_PER_REFRESH; ++i)
+		{
+			// The rest of the refresh passes without anything to go back over.
+			if (machine.is_waiting_for_key())
+			{
+				machine.run(INSTRUCTIONS_PER_REFRESH - i);
+				break;
+			}
+
+			const auto category = machine.get_current_instruction().category;
+
+			can_run_more = run_one_without_callback();
+			deliver_events(false);
+			if (!can_run_more)
+			{
+				break;
+			}
+
+			report.categories |= 1 << category;
+			++report.instructions_executed;
+		}
+
+		deliver_events(true);
+	}
+
+	if (machine.get_fault().code != Fault_code::NONE)
+	{
+		report.status = Run_status::FAULTED;
+	}
+	else if (!can_run_more)
+	{
+		report.status = Run_status::FINISHED;
+	}
+	else if (machine.is_waiting_for_key())
+	{
+		report.status = Run_status::WAITING_FOR_KEY;
+	}
+
+	for (const auto& f : frame_callbacks)
+	{
+		f(report);
+	}
+
+	return report;
 }
 
 void Debugger::on_exec(const std::function<void(Execution_event, const Instruction&)>& f)
@@ -70,6 +177,97 @@ void Debugger::on_exec(const std::function<void(Execution_event, const Instructi
 	callbacks.push_back(f);
 }
 
+void Debugger::on_frame(const std::function<void(const Frame_report&)>& f)
+{
+	frame_callbacks.push_back(f);
+}
+
+/**
+ * Calls `f` with the events which pass `filter`. Events are worked out from
+ * the instructions as they run, and only while there are subscribers.
+ */
+void Debugger::subscribe(const Debug_filter& filter, const std::function<void(const std::vector<Debug_event>&)>& f)
+{
+	auto& subscription = subscriptions.emplace_back(Subscription{ filter, f, {} });
+
+	// An instruction causes two events at most, so a refresh never outgrows
+	// this and delivering events doesn't allocate.
+	subscription.pending.reserve(2 * INSTRUCTIONS_PER_REFRESH);
+}
+
+/**
+ * Works out the events of the instruction `ins`, which has just run starting
+ * from the state `before`.
+ */
+void Debugger::collect_events(const Instruction& ins, const Processor_state& before)
+{
+	// Faulting instructions and the end of the program do nothing.
+	if (machine.cycles == before.cycles || machine.fault.code != Fault_code::NONE)
+	{
+		return;
+	}
+
+	const auto& p = ins.payload;
+	const auto event = [&](Debug_event_kind kind, double_byte address, double_byte length, std::uint32_t registers)
+	{
+		add_event(Debug_event{ kind, before.cycles, before.pc, ins.raw_instruction, address, length, registers });
+	};
+
+	const auto draws = ins.category == 0xD || ins.raw_instruction == 0x00E0;
+	if (draws && machine.frame_buffer != before.frame_buffer)
+	{
+		event(Debug_event_kind::FRAME_CHANGED, 0, 0, 0);
+	}
+
+	if (const auto length = Helper::get_memory_written(ins); length != 0)
+	{
+		event(Debug_event_kind::MEMORY_WRITE, wrap_address(before.index_register), length, 0);
+	}
+
+	if (const auto registers = Helper::get_registers_written(ins); registers != 0)
+	{
+		event(Debug_event_kind::REGISTER_WRITE, 0, 0, registers);
+	}
+
+	if (ins.category == 0x2)
+	{
+		event(Debug_event_kind::CALL, p.NNN, 0, 0);
+	}
+	else if (ins.raw_instruction == 0x00EE)
+	{
+		event(Debug_event_kind::RETURN, machine.pc, 0, 0);
+	}
+	else if (ins.category == 0xF && p.NN == 0x0A && machine.is_blocked)
+	{
+		event(Debug_event_kind::KEY_WAIT, p.X, 0, 0);
+	}
+}
+
+void Debugger::add_event(const Debug_event& event)
+{
+	for (auto& subscription : subscriptions)
+	{
+		if (Helper::matches(subscription.filter, event))
+		{
+			subscription.pending.push_back(event);
+		}
+	}
+}
+
+void Debugger::deliver_events(bool include_batched)
+{
+	for (auto& subscription : subscriptions)
+	{
+		if (subscription.pending.empty() || (subscription.filter.batched && !include_batched))
+		{
+			continue;
+		}
+
+		subscription.callback(subscription.pending);
+		subscription.pending.clear();
+	}
+}
+
 const std::array<byte, MEMORY_SIZE>& Debugger::get_memory() const
 {
 	return machine.memory;
@@ -80,6 +278,68 @@ const std::array<byte, NUM_REGISTERS>& Debugger::get_registers() const
 	return machine.registers;
 }
 
+/**
+ * Returns the memory locations whose values changed since the previous call
+ * (or since the debugger was created). Only pages the machine has written are
+ * compared, so the cost depends on how much was written rather than on the
+ * size of memory.
+ *
+ * Writes from every source count, including loading a program or restoring a
+ * snapshot, but the machine keeps a single set of changed pages, so only one
+ * debugger per machine should collect changes.
+ */
+std::vector<Memory_change> Debugger::take_memory_changes()
+{
+	std::vector<Memory_change> changes;
+	for (size_t page = 0; page < NUM_PAGES; ++page)
+	{
+		if (!(machine.changed_pages >> page & 1))
+		{
+			continue;
+		}
+
+		for (size_t address = page * PAGE_SIZE, end = address + PAGE_SIZE; address < end; ++address)
+		{
+			if (memory_baseline[address] != machine.memory[address])
+			{
+				changes.push_back(Memory_change{
+					static_cast<double_byte>(address), memory_baseline[address], machine.memory[address]
+				});
+				memory_baseline[address] = machine.memory[address];
+			}
+		}
+	}
+
+	machine.changed_pages = 0;
+	return changes;
+}
+
+/**
+ * Returns the registers whose values changed since the previous call (or since
+ * the debugger was created). The index register is reported with id
+ * NUM_REGISTERS.
+ */
+std::vector<Register_change> Debugger::take_register_changes()
+{
+	std::vector<Register_change> changes;
+	for (size_t i = 0; i < NUM_REGISTERS; ++i)
+	{
+		if (registers_baseline[i] != machine.registers[i])
+		{
+			changes.push_back(Register_change{ static_cast<byte>(i), registers_baseline[i], machine.registers[i] });
+			registers_baseline[i] = machine.registers[i];
+		}
+	}
+
+	if (index_register_baseline != machine.index_register)
+	{
+		changes.push_back(Register_change{ NUM_REGISTERS, index_register_baseline, machine.index_register });
+		index_register_baseline = machine.index_register;
+	}
+
+	return changes;
+}
+
 byte Debugger::get_register(size_t i) const
 {
 	return machine.registers[i];
@@ -95,9 +355,14 @@ double_byte Debugger::get_index_register() const
 	return machine.index_register;
 }
 
+Machine_state Debugger::get_state() const
+{
+	return machine.get_state();
+}
+
 void Debugger::set_memory_byte(size_t location, byte value)
 {
-	machine.memory[location] = value;
+	machine.write_memory(location, value);
 }
 
 void Debugger::set_register(size_t i, byte value)
@@ -114,3 +379,86 @@ void Debugger::set_index_register(double_byte value)
 {
 	machine.index_register = value;
 }
+
+bool Debugger::Helper::matches(const Debug_filter& filter, const Debug_event& event)
+{
+	if (!(filter.kinds >> static_cast<int>(event.kind) & 1))
+	{
+		return false;
+	}
+
+	switch (event.kind)
+	{
+	case Debug_event_kind::MEMORY_WRITE:
+	{
+		// Writes which run past the end of memory continue at its start.
+		const auto end = event.address + event.length;
+		return (event.address < filter.memory_end && end > filter.memory_start)
+			|| (end > MEMORY_SIZE && filter.memory_start < end - MEMORY_SIZE);
+	}
+	case Debug_event_kind::REGISTER_WRITE:
+		return (event.registers & filter.registers) != 0;
+	default:
+		return true;
+	}
+}
+
+/**
+ * The registers `ins` writes when it runs, as in Debug_event. Fx0A is left
+ * out, since its register is only written once a key is pressed.
+ */
+std::uint32_t Debugger::Helper::get_registers_written(const Instruction& ins)
+{
+	constexpr std::uint32_t VF = 1u << 0xF;
+	constexpr std::uint32_t I = 1u << NUM_REGISTERS;
+
+	const auto& p = ins.payload;
+	const auto vx = 1u << p.X;
+	switch (ins.category)
+	{
+	case 0x6: case 0x7: case 0xC:
+		return vx;
+	case 0x8:
+		return p.N == 0x0 ? vx : vx | VF;
+	case 0xA:
+		return I;
+	case 0xD:
+		return VF;
+	case 0xF:
+		switch (p.NN)
+		{
+		case 0x07:
+			return vx;
+		case 0x1E: case 0x29: case 0x55:
+			return I;
+		case 0x65:
+			return ((vx << 1) - 1) | I;
+		default:
+			return 0;
+		}
+	default:
+		return 0;
+	}
+}
+
+/**
+ * The number of bytes `ins` writes to memory, starting at the index register.
+ */
+double_byte Debugger::Helper::get_memory_written(const Instruction& ins)
+{
+	const auto& p = ins.payload;
+	if (ins.category != 0xF)
+	{
+		return 0;
+	}
+
+	switch (p.NN)
+	{
+	case 0x33:
+		return 3;
+	case 0x55:
+		return p.X + 1;
+	default:
+		return 0;
+	}
+}
\ No newline at end of file
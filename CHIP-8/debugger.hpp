@@ -1,18 +1,33 @@
 #pragma once
 
 #include <vector>
-#include <stack>
 #include <array>
 #include <functional>
 
 #include "CHIP-8.hpp"
+#include "ring-buffer.hpp"
 #include "machine-specs.hpp"
 #include "data-types.hpp"
 
+constexpr auto DEFAULT_HISTORY_SIZE = 10 * EXECUTION_SPEED /* instructions, about 10 seconds */;
+
+// Fx55 writes up to 16 bytes, which span two pages at most.
+constexpr auto MAX_PAGES_WRITTEN = 2;
+
+/**
+ * Runs a machine an instruction at a time and goes back over the last
+ * `history_size` instructions it ran; older ones are forgotten. For each, it
+ * keeps the processor state and the pages the instruction wrote as they were
+ * before, about 500 bytes, all set aside when the debugger is created so that
+ * stepping never allocates.
+ *
+ * Going back undoes what instructions did. Memory written from outside, as
+ * with set_memory_byte or by loading a program, stays as it is.
+ */
 class Debugger
 {
 public:
-	Debugger(CHIP_8& machine);
+	Debugger(CHIP_8& machine, size_t history_size = DEFAULT_HISTORY_SIZE);
 
 	bool run_one();
 	bool go_back_one();
@@ -20,13 +35,21 @@ public:
 	bool run_one_without_callback();
 	bool go_back_one_without_callback();
 
+	Frame_report run_frames(size_t num_frames);
+
 	void on_exec(const std::function<void(Execution_event, const Instruction&)>& f);
+	void on_frame(const std::function<void(const Frame_report&)>& f);
+	void subscribe(const Debug_filter& filter, const std::function<void(const std::vector<Debug_event>&)>& f);
 
 	const std::array<byte, MEMORY_SIZE>& get_memory() const;
 	const std::array<byte, NUM_REGISTERS>& get_registers() const;
 	byte get_register(size_t i) const;
 	double_byte get_pc() const;
 	double_byte get_index_register() const;
+	Machine_state get_state() const;
+
+	std::vector<Memory_change> take_memory_changes();
+	std::vector<Register_change> take_register_changes();
 
 	void set_memory_byte(size_t location, byte value);
 	void set_register(size_t i, byte value);
@@ -34,7 +57,46 @@ public:
 	void set_index_register(double_byte value);
 private:
 	CHIP_8& machine;
-	std::stack<Machine_state> states;
+
+	// What is needed to undo an instruction.
+	struct Step_record
+	{
+		Processor_state state;
+		std::array<Memory_page, MAX_PAGES_WRITTEN> pages;
+		std::array<byte, MAX_PAGES_WRITTEN> page_numbers;
+		byte num_pages;
+	};
+
+	// The most recent instructions, newest on top.
+	Ring_buffer<Step_record> steps;
+
+	// Values as of the last call to take_memory_changes/take_register_changes.
+	std::array<byte, MEMORY_SIZE> memory_baseline;
+	std::array<byte, NUM_REGISTERS> registers_baseline;
+	double_byte index_register_baseline;
 
 	std::vector<std::function<void(Execution_event, const Instruction&)>> callbacks;
+	std::vector<std::function<void(const Frame_report&)>> frame_callbacks;
+
+	// Events which passed a subscriber's filter wait in `pending` until they
+	// are delivered.
+	struct Subscription
+	{
+		Debug_filter filter;
+		std::function<void(const std::vector<Debug_event>&)> callback;
+		std::vector<Debug_event> pending;
+	};
+	std::vector<Subscription> subscriptions;
+
+	void collect_events(const Instruction& ins, const Processor_state& before);
+	void add_event(const Debug_event& event);
+	void deliver_events(bool include_batched);
+
+	class Helper
+	{
+	public:
+		static bool matches(const Debug_filter& filter, const Debug_event& event);
+		static std::uint32_t get_registers_written(const Instruction& ins);
+		static double_byte get_memory_written(const Instruction& ins);
+	};
 };
\ No newline at end of file
@@ -1,8 +1,3 @@
-#include <stdexcept>
-#include <vector>
-#include <cstdlib>
-#include <cmath>
-
 #include "executor.hpp"
 #include "CHIP-8.hpp"
 #include "helpers.hpp"
@@ -10,24 +5,18 @@
 #include "machine-specs.hpp"
 #include "data-types.hpp"
 
-using std::underflow_error;
-using std::overflow_error;
-using std::out_of_range;
-using std::invalid_argument;
-using std::vector;
-using std::pow;
-using std::rand;
+const std::array<Executor::Handler, 16> Executor::executors{
+	&Executor::category_0, &Executor::jump, &Executor::subroutine_call,
+	&Executor::skip_if_vx_eq_nn, &Executor::skip_if_vx_neq_nn,
+	&Executor::skip_if_vx_eq_vy, &Executor::set_register,
+	&Executor::inc_reg_by_const, &Executor::operate_and_assign,
+	&Executor::skip_if_vx_neq_vy, &Executor::set_index_register,
+	&Executor::jump_with_offset, &Executor::set_random, &Executor::draw,
+	&Executor::skip_cond_key, &Executor::category_F
+};
 
 Executor::Executor(CHIP_8& machine)
-	: machine{ machine }, executors{
-		&Executor::category_0, &Executor::jump, &Executor::subroutine_call,
-		&Executor::skip_if_vx_eq_nn, &Executor::skip_if_vx_neq_nn,
-		&Executor::skip_if_vx_eq_vy, &Executor::set_register,
-		&Executor::inc_reg_by_const, &Executor::operate_and_assign,
-		&Executor::skip_if_vx_neq_vy, &Executor::set_index_register,
-		&Executor::jump_with_offset, &Executor::set_random, &Executor::draw,
-		&Executor::skip_cond_key, &Executor::category_F
-	}
+	: machine{ machine }
 {
 }
 
@@ -48,30 +37,21 @@ void Executor::category_0(const Instruction::Instruction_payload& payload)
 	}
 	else
 	{
-		throw invalid_argument("category_0: machine call is not supported");
+		machine.raise_fault(Fault_code::INVALID_INSTRUCTION);
 	}
 }
 
 void Executor::jump(const Instruction::Instruction_payload& payload)
 {
-	if (payload.NNN >= machine.memory.size())
-	{
-		throw out_of_range("jump: destination is outside memory");
-	}
-
 	machine.pc = payload.NNN;
 }
 
 void Executor::subroutine_call(const Instruction::Instruction_payload& payload)
 {
-	if (payload.NNN >= machine.memory.size())
-	{
-		throw out_of_range("subroutine_call: subroutine lies outside memory");
-	}
-
 	if (machine.stack_pointer >= machine.stack.size())
 	{
-		throw overflow_error("subroutine_call: stack overflowed");
+		machine.raise_fault(Fault_code::STACK_OVERFLOW);
+		return;
 	}
 
 	machine.stack[machine.stack_pointer++] = machine.pc;
@@ -98,7 +78,8 @@ void Executor::skip_if_vx_eq_vy(const Instruction::Instruction_payload& payload)
 {
 	if (payload.N != 0)
 	{
-		throw invalid_argument("skip_if_vx_eq_vy: invalid instruction");
+		machine.raise_fault(Fault_code::INVALID_INSTRUCTION);
+		return;
 	}
 
 	if (machine.registers[payload.X] == machine.registers[payload.Y])
@@ -174,7 +155,8 @@ void Executor::operate_and_assign(const Instruction::Instruction_payload& payloa
 		break;
 	}
 	default:
-		throw invalid_argument("operate_and_assign: invalid instruction");
+		machine.raise_fault(Fault_code::INVALID_INSTRUCTION);
+		break;
 	}
 }
 
@@ -182,7 +164,8 @@ void Executor::skip_if_vx_neq_vy(const Instruction::Instruction_payload& payload
 {
 	if (payload.N != 0)
 	{
-		throw invalid_argument("skip_if_vx_neq_vy: invalid instruction");
+		machine.raise_fault(Fault_code::INVALID_INSTRUCTION);
+		return;
 	}
 
 	if (machine.registers[payload.X] != machine.registers[payload.Y])
@@ -203,8 +186,7 @@ void Executor::jump_with_offset(const Instruction::Instruction_payload& payload)
 
 void Executor::set_random(const Instruction::Instruction_payload& payload)
 {
-	const auto random = rand() % (int)pow(2, BITS_PER_BYTE);
-	machine.registers[payload.X] = random & payload.NN;
+	machine.registers[payload.X] = random_byte(machine.random_state) & payload.NN;
 }
 
 void Executor::draw(const Instruction::Instruction_payload& payload)
@@ -212,26 +194,13 @@ void Executor::draw(const Instruction::Instruction_payload& payload)
 	const auto x = machine.registers[payload.X];
 	const auto y = machine.registers[payload.Y];
 
-	const auto fb_width = machine.frame_buffer.size();
-	const auto fb_height = machine.frame_buffer[0].size();
-
 	byte vf_flag_val = 0;
 	for (size_t i = 0; i < payload.N; ++i)
 	{
-		const auto bits = machine.memory[machine.index_register + i];
-		for (size_t j = 0; j < BITS_PER_BYTE; ++j)
+		const auto bits = machine.read_memory(machine.index_register + i);
+		if (machine.frame_buffer.draw_sprite_row(x, y + i, bits))
 		{
-			const auto bit = bits & (1 << (BITS_PER_BYTE - j - 1));
-			if (!bit)
-			{
-				machine.frame_buffer[(x + j) % fb_width][(y + i) % fb_height] ^= 0;
-				continue;
-			}
-			if (machine.frame_buffer[(x + j) % fb_width][(y + i) % fb_height])
-			{
-				vf_flag_val = 1;
-			}
-			machine.frame_buffer[(x + j) % fb_width][(y + i) % fb_height] ^= 1;
+			vf_flag_val = 1;
 		}
 	}
 
@@ -240,6 +209,12 @@ void Executor::draw(const Instruction::Instruction_payload& payload)
 
 void Executor::skip_cond_key(const Instruction::Instruction_payload& payload)
 {
+	if (machine.registers[payload.X] > static_cast<byte>(Key::KF))
+	{
+		machine.raise_fault(Fault_code::INVALID_KEY);
+		return;
+	}
+
 	switch (payload.NN)
 	{
 	case 0x9E:
@@ -261,7 +236,8 @@ void Executor::skip_cond_key(const Instruction::Instruction_payload& payload)
 		break;
 	}
 	default:
-		throw invalid_argument("skip_cond_key: invalid instruction");
+		machine.raise_fault(Fault_code::INVALID_INSTRUCTION);
+		break;
 	}
 }
 
@@ -270,27 +246,29 @@ void Executor::category_F(const Instruction::Instruction_payload& payload)
 	switch (payload.NN)
 	{
 	case 0x07:
-		machine.registers[payload.X] = machine.delay_timer;
+		machine.registers[payload.X] = machine.delay_timer.value_at(machine.cycles);
 		break;
 	case 0x0A:
 	{
+		// A key which is already down completes the instruction right away.
+		// Otherwise the machine waits until the keyboard reports a press.
 		machine.is_blocked = true;
+		machine.key_wait_register = payload.X;
 		for (Key k = Key::K0; k <= Key::KF; k = static_cast<Key>((int)k + 1))
 		{
 			if (machine.keyboard.is_key_pressed(k))
 			{
-				machine.registers[payload.X] = (int)k;
-				machine.is_blocked = false;
+				machine.resume_key_wait(k);
 				break;
 			}
 		}
 		break;
 	}
 	case 0x15:
-		machine.delay_timer = machine.registers[payload.X];
+		machine.delay_timer.set(machine.cycles, machine.registers[payload.X]);
 		break;
 	case 0x18:
-		machine.sound_timer = machine.registers[payload.X];
+		machine.sound_timer.set(machine.cycles, machine.registers[payload.X]);
 		break;
 	case 0x1E:
 		machine.index_register += machine.registers[payload.X];
@@ -304,9 +282,9 @@ void Executor::category_F(const Instruction::Instruction_payload& payload)
 	case 0x33:
 	{
 		const auto digits = get_digits(machine.registers[payload.X]);
-		for (size_t i = 0, sz = digits.size(); i < sz; ++i)
+		for (size_t i = 0; i < digits.size(); ++i)
 		{
-			machine.memory[machine.index_register + i] = digits[i];
+			machine.write_memory(machine.index_register + i, digits[i]);
 		}
 		break;
 	}
@@ -314,7 +292,7 @@ void Executor::category_F(const Instruction::Instruction_payload& payload)
 	{
 		for (size_t i = 0; i <= payload.X; ++i)
 		{
-			machine.memory[machine.index_register++] = machine.registers[i];
+			machine.write_memory(machine.index_register++, machine.registers[i]);
 		}
 		break;
 	}
@@ -322,26 +300,27 @@ void Executor::category_F(const Instruction::Instruction_payload& payload)
 	{
 		for (size_t i = 0; i <= payload.X; ++i)
 		{
-			machine.registers[i] = machine.memory[machine.index_register++];
+			machine.registers[i] = machine.read_memory(machine.index_register++);
 		}
 		break;
 	}
 	default:
-		throw invalid_argument("category_F: invalid instruction");
+		machine.raise_fault(Fault_code::INVALID_INSTRUCTION);
 		break;
 	}
 }
 
 void Executor::Helper::clear_screen(CHIP_8& machine)
 {
-	machine.frame_buffer.fill({});
+	machine.frame_buffer.clear();
 }
 
 void Executor::Helper::return_(CHIP_8& machine)
 {
 	if (machine.stack_pointer == 0)
 	{
-		throw underflow_error("return_: no return address on stack");
+		machine.raise_fault(Fault_code::STACK_UNDERFLOW);
+		return;
 	}
 
 	const double_byte return_addr = machine.stack[--machine.stack_pointer];
@@ -2,17 +2,25 @@
 
 #include <array>
 
-#include "CHIP-8.hpp"
 #include "data-types.hpp"
 
+class CHIP_8;
+
+/**
+ * Carries out instructions on a machine. An Executor is only a reference to
+ * the machine, so the machine makes one whenever it needs one; the table of
+ * handlers is shared by all of them.
+ */
 class Executor
 {
 public:
 	Executor(CHIP_8& machine);
 	void execute(const Instruction& ins);
 private:
+	using Handler = void (Executor::*)(const Instruction::Instruction_payload&);
+
 	CHIP_8& machine;
-	const std::array<void(Executor::*)(const Instruction::Instruction_payload&), 16> executors;
+	static const std::array<Handler, 16> executors;
 
 	void category_0(const Instruction::Instruction_payload& payload);
 	void jump(const Instruction::Instruction_payload& payload);
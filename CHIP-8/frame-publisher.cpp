@@ -0,0 +1,305 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "frame-publisher.hpp"
+#include "CHIP-8.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+
+using std::atomic;
+using std::atomic_thread_fence;
+using std::memory_order_relaxed;
+using std::memory_order_acquire;
+using std::memory_order_release;
+using std::runtime_error;
+using std::string;
+
+constexpr std::uint32_t PUBLICATION_MAGIC = 0x46503843; /* "C8PF" */
+constexpr std::uint32_t PUBLICATION_VERSION = 2;
+
+// Readers give up on a frame after this many attempts, which only happens if
+// the publisher laps the whole ring while they read.
+constexpr auto MAX_READ_ATTEMPTS = 16;
+
+/**
+ * The layout of the shared region: a header followed by `num_slots` slots.
+ * Both sides must agree on it, so it only ever changes together with
+ * PUBLICATION_VERSION.
+ */
+struct Shared_header
+{
+	std::uint32_t magic;
+	std::uint32_t version;
+	std::uint32_t num_slots;
+
+	std::atomic<std::uint64_t> frames_published;
+};
+
+struct alignas(64) Shared_slot
+{
+	// Odd while the publisher writes the slot.
+	std::atomic<std::uint32_t> sequence;
+
+	std::uint64_t frame_number;
+	std::uint64_t cycles;
+
+	double_byte pc;
+	double_byte index_register;
+	byte stack_pointer;
+	byte delay_timer;
+	byte sound_timer;
+	byte fault_code;
+	std::array<byte, NUM_REGISTERS> registers;
+
+	// Laid out like Frame_buffer::rows.
+	std::array<std::uint64_t, FRAME_BUFFER_HEIGHT> rows;
+};
+
+constexpr auto SLOTS_OFFSET = alignof(Shared_slot);
+
+static_assert(sizeof(Shared_header) <= SLOTS_OFFSET, "the header must fit in front of the slots");
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "shared atomics must not use locks");
+
+static Shared_slot* get_slots(void* mapping)
+{
+	return reinterpret_cast<Shared_slot*>(static_cast<char*>(mapping) + SLOTS_OFFSET);
+}
+
+static const Shared_slot* get_slots(const void* mapping)
+{
+	return reinterpret_cast<const Shared_slot*>(static_cast<const char*>(mapping) + SLOTS_OFFSET);
+}
+
+#ifndef _WIN32
+static string get_shared_memory_path(const string& name)
+{
+	return name.starts_with('/') ? name : '/' + name;
+}
+#endif
+
+static void* create_mapping(const string& name, size_t size, void*& handle)
+{
+#ifdef _WIN32
+	handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, static_cast<DWORD>(size), name.c_str());
+	if (handle == nullptr)
+	{
+		return nullptr;
+	}
+
+	return MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+#else
+	handle = nullptr;
+
+	const auto fd = shm_open(get_shared_memory_path(name).c_str(), O_CREAT | O_RDWR, 0644);
+	if (fd < 0)
+	{
+		return nullptr;
+	}
+
+	void* mapping = nullptr;
+	if (ftruncate(fd, size) == 0)
+	{
+		mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+
+	return mapping == MAP_FAILED ? nullptr : mapping;
+#endif
+}
+
+static const void* open_mapping(const string& name, size_t& size, void*& handle)
+{
+#ifdef _WIN32
+	handle = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+	if (handle == nullptr)
+	{
+		return nullptr;
+	}
+
+	const auto mapping = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+	MEMORY_BASIC_INFORMATION info;
+	size = mapping && VirtualQuery(mapping, &info, sizeof(info)) ? info.RegionSize : 0;
+
+	return mapping;
+#else
+	handle = nullptr;
+
+	const auto fd = shm_open(get_shared_memory_path(name).c_str(), O_RDONLY, 0);
+	if (fd < 0)
+	{
+		return nullptr;
+	}
+
+	void* mapping = nullptr;
+	struct stat status;
+	if (fstat(fd, &status) == 0 && status.st_size > 0)
+	{
+		size = status.st_size;
+		mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+
+	return mapping == MAP_FAILED ? nullptr : mapping;
+#endif
+}
+
+static void close_mapping(const void* mapping, [[maybe_unused]] size_t size, [[maybe_unused]] void* handle)
+{
+#ifdef _WIN32
+	UnmapViewOfFile(mapping);
+	CloseHandle(handle);
+#else
+	munmap(const_cast<void*>(mapping), size);
+#endif
+}
+
+Frame_publisher::Frame_publisher(const string& name, size_t num_slots)
+	: name{ name }, mapping{ nullptr }, mapping_size{ SLOTS_OFFSET + num_slots * sizeof(Shared_slot) }, handle{ nullptr }
+{
+	if (num_slots == 0)
+	{
+		throw runtime_error("Frame_publisher: at least one slot is needed");
+	}
+
+	mapping = create_mapping(name, mapping_size, handle);
+	if (mapping == nullptr)
+	{
+		throw runtime_error("Frame_publisher: cannot create shared memory " + name);
+	}
+
+	// A fresh region is all zeroes, which is a valid state for the atomics.
+	auto header = static_cast<Shared_header*>(mapping);
+	header->num_slots = static_cast<std::uint32_t>(num_slots);
+	header->version = PUBLICATION_VERSION;
+	header->frames_published.store(0, memory_order_relaxed);
+	for (size_t i = 0; i < num_slots; ++i)
+	{
+		get_slots(mapping)[i].sequence.store(0, memory_order_relaxed);
+	}
+
+	// Readers check the magic number last.
+	atomic_thread_fence(memory_order_release);
+	header->magic = PUBLICATION_MAGIC;
+}
+
+Frame_publisher::~Frame_publisher()
+{
+	close_mapping(mapping, mapping_size, handle);
+#ifndef _WIN32
+	shm_unlink(get_shared_memory_path(name).c_str());
+#endif
+}
+
+void Frame_publisher::publish(const CHIP_8& machine)
+{
+	auto header = static_cast<Shared_header*>(mapping);
+	const auto frame_number = header->frames_published.load(memory_order_relaxed);
+	auto& slot = get_slots(mapping)[frame_number % header->num_slots];
+
+	const auto sequence = slot.sequence.load(memory_order_relaxed);
+	slot.sequence.store(sequence + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	slot.frame_number = frame_number;
+	slot.cycles = machine.cycles;
+	slot.pc = machine.pc;
+	slot.index_register = machine.index_register;
+	slot.stack_pointer = machine.stack_pointer;
+	slot.delay_timer = machine.get_delay_timer();
+	slot.sound_timer = machine.get_sound_timer();
+	slot.fault_code = static_cast<byte>(machine.fault.code);
+	slot.registers = machine.registers;
+
+	slot.rows = machine.frame_buffer.rows;
+
+	slot.sequence.store(sequence + 2, memory_order_release);
+	header->frames_published.store(frame_number + 1, memory_order_release);
+}
+
+Frame_reader::Frame_reader(const string& name)
+	: mapping{ nullptr }, mapping_size{ 0 }, handle{ nullptr }
+{
+	mapping = open_mapping(name, mapping_size, handle);
+	if (mapping == nullptr)
+	{
+		throw runtime_error("Frame_reader: nothing is published as " + name);
+	}
+
+	const auto header = static_cast<const Shared_header*>(mapping);
+	const auto is_valid = mapping_size >= SLOTS_OFFSET
+		&& header->magic == PUBLICATION_MAGIC
+		&& header->version == PUBLICATION_VERSION
+		&& header->num_slots > 0
+		&& mapping_size >= SLOTS_OFFSET + header->num_slots * sizeof(Shared_slot);
+	atomic_thread_fence(memory_order_acquire);
+
+	if (!is_valid)
+	{
+		close_mapping(mapping, mapping_size, handle);
+		throw runtime_error("Frame_reader: " + name + " is not a compatible publication");
+	}
+}
+
+Frame_reader::~Frame_reader()
+{
+	close_mapping(mapping, mapping_size, handle);
+}
+
+/**
+ * The slot's fields are copied while the publisher may be writing them; the
+ * sequence number tells afterwards whether the copy can be trusted.
+ */
+bool Frame_reader::read_latest(Published_frame& frame) const
+{
+	const auto header = static_cast<const Shared_header*>(mapping);
+
+	for (int attempt = 0; attempt < MAX_READ_ATTEMPTS; ++attempt)
+	{
+		const auto frames_published = header->frames_published.load(memory_order_acquire);
+		if (frames_published == 0)
+		{
+			return false;
+		}
+
+		const auto& slot = get_slots(mapping)[(frames_published - 1) % header->num_slots];
+
+		const auto sequence = slot.sequence.load(memory_order_acquire);
+		if (sequence % 2 != 0)
+		{
+			continue;
+		}
+
+		frame.frame_number = slot.frame_number;
+		frame.cycles = slot.cycles;
+		frame.pc = slot.pc;
+		frame.index_register = slot.index_register;
+		frame.stack_pointer = slot.stack_pointer;
+		frame.delay_timer = slot.delay_timer;
+		frame.sound_timer = slot.sound_timer;
+		frame.fault_code = static_cast<Fault_code>(slot.fault_code);
+		frame.registers = slot.registers;
+		frame.frame_buffer.rows = slot.rows;
+
+		atomic_thread_fence(memory_order_acquire);
+		if (slot.sequence.load(memory_order_relaxed) != sequence)
+		{
+			continue;
+		}
+
+		return true;
+	}
+
+	return false;
+}
\ No newline at end of file
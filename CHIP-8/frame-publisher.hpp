@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "CHIP-8.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+
+/**
+ * What a Frame_reader sees of a machine after one of its frames.
+ */
+struct Published_frame
+{
+	std::uint64_t frame_number;
+	std::uint64_t cycles;
+
+	double_byte pc;
+	double_byte index_register;
+	byte stack_pointer;
+	byte delay_timer;
+	byte sound_timer;
+	Fault_code fault_code;
+	std::array<byte, NUM_REGISTERS> registers;
+
+	Frame_buffer frame_buffer;
+};
+
+/**
+ * Publishes a machine's frames to a named shared memory region, where any
+ * number of Frame_readers in other processes can watch them.
+ *
+ * The region holds a ring of slots, each guarded by a sequence lock: the
+ * publisher marks a slot as being written, fills it in and marks it as done,
+ * and readers retry when they see the mark change under them. The publisher
+ * never waits for readers, so a slow or stuck reader costs the emulation
+ * nothing.
+ */
+class Frame_publisher
+{
+public:
+	explicit Frame_publisher(const std::string& name, size_t num_slots = 8);
+	~Frame_publisher();
+
+	Frame_publisher(const Frame_publisher&) = delete;
+	Frame_publisher& operator=(const Frame_publisher&) = delete;
+
+	void publish(const CHIP_8& machine);
+private:
+	std::string name;
+	void* mapping;
+	size_t mapping_size;
+	void* handle;
+};
+
+/**
+ * Reads the frames published under a name by a Frame_publisher.
+ */
+class Frame_reader
+{
+public:
+	explicit Frame_reader(const std::string& name);
+	~Frame_reader();
+
+	Frame_reader(const Frame_reader&) = delete;
+	Frame_reader& operator=(const Frame_reader&) = delete;
+
+	// Returns false if nothing was published yet, or if the publisher kept
+	// overwriting the frame while it was being read.
+	bool read_latest(Published_frame& frame) const;
+private:
+	const void* mapping;
+	size_t mapping_size;
+	void* handle;
+};
\ No newline at end of file
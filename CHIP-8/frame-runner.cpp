@@ -0,0 +1,150 @@
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "frame-runner.hpp"
+#include "CHIP-8.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+#include "keyboard.hpp"
+#include "telemetry.hpp"
+#include "frame-publisher.hpp"
+
+using std::chrono::steady_clock;
+using std::chrono::nanoseconds;
+using std::lock_guard;
+using std::unique_lock;
+
+// A runner further behind than this gives up on the frames it missed.
+constexpr auto MAX_FRAMES_BEHIND = 4;
+
+Frame_runner::Frame_runner(CHIP_8& machine, size_t instructions_per_frame)
+	: machine{ machine }, instructions_per_frame{ instructions_per_frame },
+	running{ false }, frame_count{ 0 }, status{ Run_status::RUNNING }, publisher{ nullptr }
+{
+}
+
+Frame_runner::~Frame_runner()
+{
+	stop();
+}
+
+void Frame_runner::start()
+{
+	lock_guard<std::mutex> lock{ mutex };
+	if (running)
+	{
+		return;
+	}
+
+	running = true;
+	thread = std::thread{ &Frame_runner::run, this };
+}
+
+void Frame_runner::stop()
+{
+	{
+		lock_guard<std::mutex> lock{ mutex };
+		running = false;
+	}
+	wake_up.notify_all();
+
+	if (thread.joinable())
+	{
+		thread.join();
+	}
+}
+
+bool Frame_runner::is_running() const
+{
+	lock_guard<std::mutex> lock{ mutex };
+	return running;
+}
+
+void Frame_runner::set_key_pressed(Key k)
+{
+	lock_guard<std::mutex> lock{ mutex };
+	machine.keyboard.set_key_pressed(k);
+}
+
+void Frame_runner::set_key_released(Key k)
+{
+	lock_guard<std::mutex> lock{ mutex };
+	machine.keyboard.set_key_released(k);
+}
+
+std::uint64_t Frame_runner::get_frame_count() const
+{
+	lock_guard<std::mutex> lock{ mutex };
+	return frame_count;
+}
+
+Run_status Frame_runner::get_status() const
+{
+	lock_guard<std::mutex> lock{ mutex };
+	return status;
+}
+
+Frame_buffer Frame_runner::get_frame_buffer() const
+{
+	lock_guard<std::mutex> lock{ mutex };
+	return machine.get_frame_buffer();
+}
+
+void Frame_runner::set_publisher(Frame_publisher* publisher)
+{
+	lock_guard<std::mutex> lock{ mutex };
+	this->publisher = publisher;
+}
+
+/**
+ * Can be called at any time, the counters are not guarded by the mutex.
+ */
+Telemetry_counters Frame_runner::get_telemetry() const
+{
+	return telemetry.read();
+}
+
+/**
+ * Runs frames until stopped. A runner which falls behind runs the frames it
+ * missed back to back, unless it is more than MAX_FRAMES_BEHIND frames behind,
+ * in which case it skips them.
+ */
+void Frame_runner::run()
+{
+	constexpr nanoseconds frame_period{ NANOSECONDS_PER_REFRESH };
+
+	auto next_frame = steady_clock::now();
+
+	unique_lock<std::mutex> lock{ mutex };
+	while (running)
+	{
+		const auto frame_start = steady_clock::now();
+		const auto result = machine.run(instructions_per_frame);
+		if (publisher)
+		{
+			publisher->publish(machine);
+		}
+		const auto frame_end = steady_clock::now();
+
+		status = result.status;
+		++frame_count;
+		telemetry.add_execution(result.instructions_executed, frame_end - frame_start);
+
+		next_frame += frame_period;
+
+		const auto frames_behind = (frame_end - next_frame) / frame_period;
+		if (frames_behind > MAX_FRAMES_BEHIND)
+		{
+			next_frame += frames_behind * frame_period;
+			telemetry.add_frames(1, frames_behind);
+			telemetry.add_missed_timer_ticks(frames_behind * TIMER_DECREMENTS_PER_REFRESH);
+		}
+		else
+		{
+			telemetry.add_frames(1, 0);
+		}
+
+		wake_up.wait_until(lock, next_frame, [this] { return !running; });
+	}
+}
\ No newline at end of file
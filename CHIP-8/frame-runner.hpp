@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "CHIP-8.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+#include "keyboard.hpp"
+#include "telemetry.hpp"
+#include "frame-publisher.hpp"
+
+/**
+ * Drives a machine from a background thread, one frame every
+ * NANOSECONDS_PER_REFRESH, so that a host only has to poll for finished
+ * frames and forward key presses.
+ *
+ * While the runner is started, the machine must only be accessed through it.
+ */
+class Frame_runner
+{
+public:
+	explicit Frame_runner(CHIP_8& machine, size_t instructions_per_frame = INSTRUCTIONS_PER_REFRESH);
+	~Frame_runner();
+
+	Frame_runner(const Frame_runner&) = delete;
+	Frame_runner& operator=(const Frame_runner&) = delete;
+
+	void start();
+	void stop();
+	bool is_running() const;
+
+	void set_key_pressed(Key k);
+	void set_key_released(Key k);
+
+	std::uint64_t get_frame_count() const;
+	Run_status get_status() const;
+	Frame_buffer get_frame_buffer() const;
+	Telemetry_counters get_telemetry() const;
+
+	// Every finished frame is published, if there is a publisher.
+	void set_publisher(Frame_publisher* publisher);
+private:
+	void run();
+
+	CHIP_8& machine;
+	size_t instructions_per_frame;
+
+	// Guards the machine and everything below.
+	mutable std::mutex mutex;
+	std::condition_variable wake_up;
+	bool running;
+
+	std::uint64_t frame_count;
+	Run_status status;
+
+	Telemetry telemetry;
+	Frame_publisher* publisher;
+
+	std::thread thread;
+};
\ No newline at end of file
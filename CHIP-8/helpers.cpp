@@ -1,14 +1,12 @@
-#include <vector>
-#include <stdexcept>
-#include <algorithm>
+#include <array>
+#include <istream>
+#include <iterator>
 
 #include "helpers.hpp"
 #include "machine-specs.hpp"
 #include "data-types.hpp"
 
-using std::vector;
-using std::reverse;
-using std::out_of_range;
+using std::array;
 
 double_byte concatenate_bytes(byte b1, byte b2)
 {
@@ -23,52 +21,42 @@ double_byte concatenate_bytes(byte b1, byte b2)
  * Example: Let's say the given double_byte contains the value 0xABCD. We can
  * request nibbles of in the range 1 to 2, i.e., 0xBC.
  * get_nibbles_in_range(0xABCD, 1, 2) will return 0x00BC.
+ *
+ * The range must satisfy 0 <= first <= last <= 3.
  */
 double_byte get_nibbles_in_range(double_byte b, int first, int last)
 {
-	constexpr auto NIBBLES_PER_BYTE = BITS_PER_BYTE / BITS_PER_NIBBLE;
 	constexpr auto NIBBLES_PER_DOUBLE_BYTE = 2 * NIBBLES_PER_BYTE;
 
-	if (last >= NIBBLES_PER_DOUBLE_BYTE)
-	{
-		throw out_of_range("get_nibbles_in_range: requested nibble is outside byte");
-	}
-
 	// shift so that all useless nibbles on the right are discarded
 	// bits are useless if they occur after `last`
 	b >>= (NIBBLES_PER_DOUBLE_BYTE - last - 1) * BITS_PER_NIBBLE;
 
-	const auto num_nibbles_to_extract = last - first + 1;
-
-	if (num_nibbles_to_extract <= 0 || num_nibbles_to_extract > NIBBLES_PER_DOUBLE_BYTE)
-	{
-		throw out_of_range("get_nibbles_in_range: requested nibble is outside byte");
-	}
-
 	// To set bits not in range to 0, we need a mask.
 	// Notice that if we have 0x0ABC and we want to keep the last two nibbles,
 	// we can BITAND with 0xFF (which is 16 * 16 - 1).
-	unsigned mask = 1 << BITS_PER_NIBBLE;
-	for (auto i = 1; i < num_nibbles_to_extract; ++i)
-	{
-		mask *= 1 << BITS_PER_NIBBLE;
-	}
+	const auto num_nibbles_to_extract = last - first + 1;
+	const unsigned mask = (1u << (num_nibbles_to_extract * BITS_PER_NIBBLE)) - 1;
 
-	return b & (mask - 1);
+	return b & mask;
 }
 
-vector<int> get_digits(size_t num)
+array<byte, 3> get_digits(byte num)
 {
-	vector<int> digits;
+	return array<byte, 3>{
+		static_cast<byte>(num / 100),
+		static_cast<byte>(num / 10 % 10),
+		static_cast<byte>(num % 10),
+	};
+}
 
-	for (; num != 0; num /= 10)
-	{
-		const auto d = num % 10;
-		digits.push_back(d);
-	}
+byte random_byte(std::uint32_t& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
 
-	reverse(digits.begin(), digits.end());
-	return digits;
+	return static_cast<byte>(state >> 24);
 }
 
 byte get_most_significant_bit(byte value)
@@ -79,4 +67,35 @@ byte get_most_significant_bit(byte value)
 byte get_least_significant_bit(byte value)
 {
 	return value & 1;
+}
+
+std::uint64_t hash_frame_buffer(const Frame_buffer& frame_buffer)
+{
+	constexpr auto FNV_OFFSET_BASIS = std::uint64_t{ 14695981039346656037u };
+	constexpr auto FNV_PRIME = std::uint64_t{ 1099511628211u };
+
+	auto hash = FNV_OFFSET_BASIS;
+	for (const auto row : frame_buffer.rows)
+	{
+		for (size_t i = 0; i < sizeof(row); ++i)
+		{
+			hash ^= (row >> (i * BITS_PER_BYTE)) & 0xFF;
+			hash *= FNV_PRIME;
+		}
+	}
+
+	return hash;
+}
+
+array<byte, MAX_NUM_INSTRUCTIONS * INSTRUCTION_SIZE> read_program(std::istream& stream)
+{
+	array<byte, MAX_NUM_INSTRUCTIONS * INSTRUCTION_SIZE> bytes{};
+
+	std::istreambuf_iterator<char> in{ stream };
+	for (size_t i = 0; i < bytes.size() && in != std::istreambuf_iterator<char>{}; ++i, ++in)
+	{
+		bytes[i] = static_cast<byte>(*in);
+	}
+
+	return bytes;
 }
\ No newline at end of file
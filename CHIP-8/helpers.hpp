@@ -1,8 +1,11 @@
 #pragma once
 
-#include <vector>
+#include <array>
+#include <cstdint>
+#include <istream>
 
 #include "data-types.hpp"
+#include "machine-specs.hpp"
 
 double_byte concatenate_bytes(byte b1, byte b2);
 
@@ -14,10 +17,35 @@ double_byte concatenate_bytes(byte b1, byte b2);
  * Example: Let's say the given double_byte contains the value 0xABCD. We can
  * request nibbles of in the range 1 to 2, i.e., 0xBC.
  * get_nibbles_in_range(0xABCD, 1, 2) will return 0x00BC.
+ *
+ * The range must satisfy 0 <= first <= last <= 3.
  */
 double_byte get_nibbles_in_range(double_byte b, int first, int last);
 
-std::vector<int> get_digits(size_t num);
+/**
+ * The decimal digits of `num`, hundreds first. Numbers below 100 get leading
+ * zeros, as Fx33 always stores three digits.
+ */
+std::array<byte, 3> get_digits(byte num);
+
+/**
+ * Advances a xorshift generator and returns its next byte. `state` must not be
+ * 0.
+ */
+byte random_byte(std::uint32_t& state);
+
+/**
+ * 64-bit FNV-1a hash of the screen, for comparing frames cheaply. Each row is
+ * hashed as 8 little endian bytes in which bit x is the pixel in column x, so
+ * the hash doesn't depend on the byte order of the host.
+ */
+std::uint64_t hash_frame_buffer(const Frame_buffer& frame_buffer);
+
+/**
+ * Reads a ROM from a binary stream for CHIP_8::load_program_from_bytes: its
+ * bytes up to as many as fit in memory, and zeros after its end.
+ */
+std::array<byte, MAX_NUM_INSTRUCTIONS * INSTRUCTION_SIZE> read_program(std::istream& stream);
 
 byte get_most_significant_bit(byte num);
 byte get_least_significant_bit(byte num);
\ No newline at end of file
@@ -1,24 +1,84 @@
+#include <cstdint>
+
 #include "keyboard.hpp"
+#include "CHIP-8.hpp"
+
+static Key_mask get_key_bit(Key k)
+{
+	return k <= Key::KF ? Key_mask(1u << static_cast<int>(k)) : 0;
+}
 
 Keyboard::Keyboard()
+	: statuses{ 0 }, machine{ nullptr }
 {
-	for (auto k = Key::K0; k <= Key::KF; k = static_cast<Key>((int)k + 1))
-	{
-		statuses[k] = false;
-	}
+}
+
+Keyboard::Keyboard(const Keyboard& other)
+	: statuses{ other.statuses }, machine{ nullptr }
+{
+}
+
+Keyboard& Keyboard::operator=(const Keyboard& other)
+{
+	statuses = other.statuses;
+	return *this;
 }
 
 void Keyboard::set_key_pressed(Key k)
 {
-	statuses[k] = true;
+	const auto bit = get_key_bit(k);
+	if (bit == 0 || (statuses & bit))
+	{
+		return;
+	}
+
+	statuses |= bit;
+	if (machine != nullptr)
+	{
+		machine->on_key_changed(k, true);
+	}
 }
 
 void Keyboard::set_key_released(Key k)
 {
-	statuses[k] = false;
+	const auto bit = get_key_bit(k);
+	if (!(statuses & bit))
+	{
+		return;
+	}
+
+	statuses &= ~bit;
+	if (machine != nullptr)
+	{
+		machine->on_key_changed(k, false);
+	}
 }
 
 bool Keyboard::is_key_pressed(Key k) const
 {
-	return statuses.at(k);
+	return statuses & get_key_bit(k);
+}
+
+/**
+ * Presses and releases keys, in order, until exactly `keys` are pressed. The
+ * machine is told about every change, as if they were pressed one at a time.
+ */
+void Keyboard::set_pressed_keys(Key_mask keys)
+{
+	for (int k = 0; k <= static_cast<int>(Key::KF); ++k)
+	{
+		if (keys >> k & 1)
+		{
+			set_key_pressed(static_cast<Key>(k));
+		}
+		else
+		{
+			set_key_released(static_cast<Key>(k));
+		}
+	}
+}
+
+Key_mask Keyboard::get_pressed_keys() const
+{
+	return statuses;
 }
\ No newline at end of file
@@ -1,12 +1,19 @@
 #pragma once
 
-#include <unordered_map>
+#include <cstdint>
 
 enum class Key
 {
 	K0, K1, K2, K3, K4, K5, K6, K7, K8, K9, KA, KB, KC, KD, KE, KF, NONE
 };
 
+/**
+ * A set of keys: bit k is set if key k is in it.
+ */
+using Key_mask = std::uint16_t;
+
+class CHIP_8;
+
 class Keyboard
 {
 public:
@@ -15,7 +22,23 @@ public:
 
 	bool is_key_pressed(Key k) const;
 
+	void set_pressed_keys(Key_mask keys);
+	Key_mask get_pressed_keys() const;
+
 	Keyboard();
+
+	// Copies only the key statuses. The machine belongs to the keyboard it
+	// was created with.
+	Keyboard(const Keyboard& other);
+	Keyboard& operator=(const Keyboard& other);
 private:
-	std::unordered_map<Key, bool> statuses;
+	// The keys which are pressed.
+	Key_mask statuses;
+
+	// The CHIP_8 which owns the keyboard, if any. It is told about every
+	// change of a key's status, so that it can resume a machine waiting for a
+	// key and record the change if needed.
+	CHIP_8* machine;
+
+	friend class CHIP_8;
 };
\ No newline at end of file
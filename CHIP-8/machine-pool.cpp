@@ -0,0 +1,72 @@
+#include <memory>
+#include <stdexcept>
+
+#include "machine-pool.hpp"
+#include "CHIP-8.hpp"
+
+using std::make_unique;
+using std::invalid_argument;
+
+/**
+ * Returns a machine in the state captured by `snapshot`.
+ */
+CHIP_8& Machine_pool::acquire(const CHIP_8::Snapshot& snapshot)
+{
+	CHIP_8* machine = nullptr;
+	if (free_machines.empty())
+	{
+		machines.push_back(make_unique<CHIP_8>());
+		machine = machines.back().get();
+	}
+	else
+	{
+		machine = free_machines.back();
+		free_machines.pop_back();
+	}
+	is_free[machine] = false;
+
+	machine->restore_snapshot(snapshot);
+	return *machine;
+}
+
+/**
+ * Returns a machine in the same state as `machine`, including the keyboard.
+ * `machine` keeps sharing its memory with the clone until either writes to it.
+ */
+CHIP_8& Machine_pool::clone(CHIP_8& machine)
+{
+	auto& copy = acquire(machine.take_snapshot());
+	copy.keyboard = machine.keyboard;
+
+	return copy;
+}
+
+/**
+ * Hands `machine` back to the pool. It must have come from this pool and not
+ * have been released since.
+ */
+void Machine_pool::release(CHIP_8& machine)
+{
+	const auto owned = is_free.find(&machine);
+	if (owned == is_free.end())
+	{
+		throw invalid_argument("Machine_pool: the machine doesn't belong to this pool");
+	}
+	if (owned->second)
+	{
+		throw invalid_argument("Machine_pool: the machine has already been released");
+	}
+
+	owned->second = true;
+	free_machines.push_back(&machine);
+}
+
+size_t Machine_pool::size() const
+{
+	return machines.size();
+}
+
+size_t Machine_pool::num_free() const
+{
+	return free_machines.size();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include "CHIP-8.hpp"
+
+/**
+ * Recycles CHIP_8 objects for searches which fork a machine many times and
+ * throw most of the branches away.
+ *
+ * Machines handed out by the pool stay owned by it. A released machine keeps
+ * its memory, so acquiring it again for a snapshot of the same lineage only
+ * copies the pages that differ.
+ */
+class Machine_pool
+{
+public:
+	CHIP_8& acquire(const CHIP_8::Snapshot& snapshot);
+	CHIP_8& clone(CHIP_8& machine);
+	void release(CHIP_8& machine);
+
+	size_t size() const;
+	size_t num_free() const;
+private:
+	std::vector<std::unique_ptr<CHIP_8>> machines;
+	std::vector<CHIP_8*> free_machines;
+	// Whether each machine of the pool is free, so release checks in constant time.
+	std::unordered_map<const CHIP_8*, bool> is_free;
+};
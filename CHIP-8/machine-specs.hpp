@@ -7,6 +7,9 @@ constexpr auto BITS_PER_NIBBLE = 4;
 constexpr auto NIBBLES_PER_BYTE = BITS_PER_BYTE / BITS_PER_NIBBLE;
 
 constexpr auto MEMORY_SIZE = 4096 /* bytes */;
+constexpr auto ADDRESS_MASK = MEMORY_SIZE - 1; /* addresses are 12 bits wide, see wrap_address */
+constexpr auto PAGE_SIZE = 64 /* bytes, one per bit of a std::uint64_t */;
+constexpr auto NUM_PAGES = MEMORY_SIZE / PAGE_SIZE; /* must fit in the bits of a std::uint64_t */
 constexpr auto STACK_SIZE = 32 /* bytes */;
 constexpr auto STACK_ENTRY_SIZE = 2 /* bytes */;
 
@@ -27,5 +30,11 @@ constexpr auto EXECUTION_SPEED = 540; /* instructions per second */
 const auto MILLISECONDS_PER_INSTRUCTION = std::ceil(double(MILLISECONDS_PER_SECOND) / EXECUTION_SPEED);
 constexpr auto SCREEN_REFRESHES_PER_SECOND = 60; /* FPS */
 constexpr auto MILLISECONDS_PER_REFRESH = MILLISECONDS_PER_SECOND / SCREEN_REFRESHES_PER_SECOND;
+constexpr auto NANOSECONDS_PER_REFRESH = 1'000'000'000LL / SCREEN_REFRESHES_PER_SECOND; /* exact, unlike the above */
 constexpr auto INSTRUCTIONS_PER_REFRESH = EXECUTION_SPEED / SCREEN_REFRESHES_PER_SECOND;
-constexpr auto TIMER_DECREMENTS_PER_REFRESH = 1;
\ No newline at end of file
+constexpr auto TIMER_DECREMENTS_PER_REFRESH = 1;
+constexpr auto CYCLES_PER_TIMER_TICK = INSTRUCTIONS_PER_REFRESH / TIMER_DECREMENTS_PER_REFRESH; /* one cycle per instruction */
+
+constexpr auto MAX_MACHINE_SIZE = 4800 /* bytes, see CHIP_8 */;
+
+constexpr auto DEFAULT_RANDOM_SEED = 2463534242u; /* any value but 0 */
\ No newline at end of file
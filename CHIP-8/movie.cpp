@@ -0,0 +1,244 @@
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <algorithm>
+
+#include "movie.hpp"
+#include "CHIP-8.hpp"
+#include "keyboard.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+
+using std::istream;
+using std::ostream;
+using std::runtime_error;
+using std::min;
+
+/**
+ * Movie files start with MOVIE_MAGIC, followed by
+ *
+ *     version       1 byte
+ *     seed          4 bytes, little endian
+ *     end cycle     varint
+ *     event count   varint
+ *     events
+ *
+ * Each event is the number of cycles since the previous event as a varint,
+ * then a byte with the event kind in the high nibble and the key in the low
+ * nibble.
+ *
+ * Varints are little endian groups of 7 bits, where the high bit of each byte
+ * says whether another byte follows.
+ */
+constexpr char MOVIE_MAGIC[] = { 'C', '8', 'M', 'V' };
+constexpr byte MOVIE_VERSION = 2; /* 1 also recorded timer decrements */
+
+static void write_varint(ostream& stream, std::uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		stream.put(static_cast<char>((value & 0x7F) | 0x80));
+		value >>= 7;
+	}
+	stream.put(static_cast<char>(value));
+}
+
+static byte read_byte(istream& stream)
+{
+	const auto b = stream.get();
+	if (b == istream::traits_type::eof())
+	{
+		throw runtime_error("load_movie: unexpected end of movie");
+	}
+
+	return static_cast<byte>(b);
+}
+
+static std::uint64_t read_varint(istream& stream)
+{
+	std::uint64_t value = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		const auto b = read_byte(stream);
+		value |= std::uint64_t{ b & 0x7Fu } << shift;
+
+		if (!(b & 0x80))
+		{
+			return value;
+		}
+	}
+
+	throw runtime_error("load_movie: malformed number");
+}
+
+void save_movie(const Movie& movie, ostream& stream)
+{
+	stream.write(MOVIE_MAGIC, sizeof(MOVIE_MAGIC));
+	stream.put(static_cast<char>(MOVIE_VERSION));
+	for (int i = 0; i < 4; ++i)
+	{
+		stream.put(static_cast<char>(movie.seed >> (8 * i)));
+	}
+
+	write_varint(stream, movie.end_cycle);
+	write_varint(stream, movie.events.size());
+
+	std::uint64_t previous_cycle = 0;
+	for (const auto& event : movie.events)
+	{
+		write_varint(stream, event.cycle - previous_cycle);
+		previous_cycle = event.cycle;
+
+		stream.put(static_cast<char>(static_cast<byte>(event.kind) << 4 | (event.value & 0xF)));
+	}
+}
+
+Movie load_movie(istream& stream)
+{
+	for (const auto c : MOVIE_MAGIC)
+	{
+		if (read_byte(stream) != static_cast<byte>(c))
+		{
+			throw runtime_error("load_movie: not a movie");
+		}
+	}
+
+	if (read_byte(stream) != MOVIE_VERSION)
+	{
+		throw runtime_error("load_movie: unsupported version");
+	}
+
+	Movie movie{};
+	for (int i = 0; i < 4; ++i)
+	{
+		movie.seed |= std::uint32_t{ read_byte(stream) } << (8 * i);
+	}
+
+	movie.end_cycle = read_varint(stream);
+
+	const auto num_events = read_varint(stream);
+	std::uint64_t cycle = 0;
+	for (std::uint64_t i = 0; i < num_events; ++i)
+	{
+		cycle += read_varint(stream);
+
+		const auto tag = read_byte(stream);
+		const auto kind = static_cast<Movie_event_kind>(tag >> 4);
+		switch (kind)
+		{
+		case Movie_event_kind::KEY_RELEASED:
+		case Movie_event_kind::KEY_PRESSED:
+			movie.events.push_back(Movie_event{ cycle, kind, static_cast<byte>(tag & 0xF) });
+			break;
+		default:
+			throw runtime_error("load_movie: unknown event");
+		}
+	}
+
+	return movie;
+}
+
+Movie_recorder::Movie_recorder(CHIP_8& machine, std::uint32_t seed)
+	: machine{ machine }, movie{ seed, machine.get_cycle_count(), {} }
+{
+	machine.seed_random(seed);
+	machine.recorder = this;
+}
+
+Movie_recorder::~Movie_recorder()
+{
+	if (machine.recorder == this)
+	{
+		machine.recorder = nullptr;
+	}
+}
+
+const Movie& Movie_recorder::get_movie()
+{
+	movie.end_cycle = machine.get_cycle_count();
+	return movie;
+}
+
+void Movie_recorder::record(Movie_event_kind kind, byte value)
+{
+	movie.events.push_back(Movie_event{ machine.get_cycle_count(), kind, value });
+}
+
+Movie_player::Movie_player(CHIP_8& machine, const Movie& movie)
+	: machine{ machine }, movie{ movie }, next_event{ 0 }
+{
+	machine.seed_random(movie.seed);
+}
+
+/**
+ * Replays up to `max_instructions` cycles, stopping early at the end of the
+ * movie or when the machine stops running.
+ */
+Run_result Movie_player::run(std::size_t max_instructions)
+{
+	const auto now = machine.get_cycle_count();
+	return play(max_instructions < UINT64_MAX - now ? now + max_instructions : UINT64_MAX);
+}
+
+/**
+ * Replays `num_frames` refreshes' worth of cycles.
+ */
+Run_result Movie_player::run_frames(std::size_t num_frames)
+{
+	return run(num_frames * INSTRUCTIONS_PER_REFRESH);
+}
+
+bool Movie_player::is_finished() const
+{
+	return next_event == movie.events.size() && machine.get_cycle_count() >= movie.end_cycle;
+}
+
+/**
+ * Runs the machine until cycle `end`, delivering the events due on the way.
+ */
+Run_result Movie_player::play(std::uint64_t end)
+{
+	auto result = Run_result{ 0, Run_status::RUNNING };
+
+	for (;;)
+	{
+		const auto now = machine.get_cycle_count();
+		for (; next_event < movie.events.size() && movie.events[next_event].cycle <= now; ++next_event)
+		{
+			const auto& event = movie.events[next_event];
+			switch (event.kind)
+			{
+			case Movie_event_kind::KEY_RELEASED:
+				machine.keyboard.set_key_released(static_cast<Key>(event.value));
+				break;
+			case Movie_event_kind::KEY_PRESSED:
+				machine.keyboard.set_key_pressed(static_cast<Key>(event.value));
+				break;
+			}
+		}
+
+		const auto stop = min(end, next_event < movie.events.size() ? movie.events[next_event].cycle : movie.end_cycle);
+		if (now >= stop)
+		{
+			if (result.status == Run_status::WAITING_FOR_KEY && !machine.is_waiting_for_key())
+			{
+				result.status = Run_status::RUNNING;
+			}
+
+			return result;
+		}
+
+		// Waiting for a key uses up the cycles until the next event, which
+		// may be the key.
+		const auto run_result = machine.run(static_cast<std::size_t>(stop - now));
+		result.instructions_executed += run_result.instructions_executed;
+		result.status = run_result.status;
+
+		if (run_result.status != Run_status::RUNNING && run_result.status != Run_status::WAITING_FOR_KEY)
+		{
+			return result;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <istream>
+#include <ostream>
+
+#include "data-types.hpp"
+
+class CHIP_8;
+
+enum class Movie_event_kind : byte
+{
+	KEY_RELEASED, KEY_PRESSED
+};
+
+/**
+ * One input from the host. `value` is the key.
+ */
+struct Movie_event
+{
+	std::uint64_t cycle;
+	Movie_event_kind kind;
+	byte value;
+};
+
+/**
+ * Everything a host fed into a machine, from the moment its program was
+ * loaded until `end_cycle`. Replaying a movie into a machine with the same
+ * program reproduces the run exactly.
+ */
+struct Movie
+{
+	std::uint32_t seed;
+	std::uint64_t end_cycle;
+	std::vector<Movie_event> events;
+};
+
+void save_movie(const Movie& movie, std::ostream& stream);
+Movie load_movie(std::istream& stream);
+
+/**
+ * Records the key presses and releases a machine receives, stamped with the
+ * cycle they arrived at. The timers run on the machine's cycles, so they need
+ * no recording.
+ *
+ * Create the recorder right after loading the program. It seeds the machine's
+ * random number generator, and stops recording when destroyed.
+ */
+class Movie_recorder
+{
+public:
+	Movie_recorder(CHIP_8& machine, std::uint32_t seed);
+	~Movie_recorder();
+
+	Movie_recorder(const Movie_recorder&) = delete;
+	Movie_recorder& operator=(const Movie_recorder&) = delete;
+
+	const Movie& get_movie();
+private:
+	void record(Movie_event_kind kind, byte value);
+
+	CHIP_8& machine;
+	Movie movie;
+
+	friend class CHIP_8;
+};
+
+/**
+ * Replays a movie into a machine whose program was just loaded, delivering
+ * every event at exactly the cycle it was recorded at. Nothing throttles the
+ * replay, so it runs as fast as the machine can.
+ */
+class Movie_player
+{
+public:
+	Movie_player(CHIP_8& machine, const Movie& movie);
+
+	Run_result run(std::size_t max_instructions);
+	Run_result run_frames(std::size_t num_frames);
+
+	bool is_finished() const;
+private:
+	Run_result play(std::uint64_t end);
+
+	CHIP_8& machine;
+	Movie movie;
+	std::size_t next_event;
+};
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "render.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+
+static_assert(sizeof(Rgba) == RGBA_BYTES_PER_PIXEL, "a color must be laid out like a pixel");
+
+// Every byte with its bits in reverse order, which puts the leftmost of 8
+// pixels of a row first.
+static constexpr auto REVERSED_BYTES = []
+{
+	std::array<byte, 256> reversed{};
+	for (std::size_t i = 0; i < reversed.size(); ++i)
+	{
+		for (std::size_t j = 0; j < BITS_PER_BYTE; ++j)
+		{
+			reversed[i] |= static_cast<byte>((i >> j & 1) << (BITS_PER_BYTE - j - 1));
+		}
+	}
+	return reversed;
+}();
+
+// Every byte spread out into 8 bytes, one per bit, lowest bit first.
+static constexpr auto SPREAD_BYTES = []
+{
+	std::array<std::array<byte, BITS_PER_BYTE>, 256> spread{};
+	for (std::size_t i = 0; i < spread.size(); ++i)
+	{
+		for (std::size_t j = 0; j < BITS_PER_BYTE; ++j)
+		{
+			spread[i][j] = static_cast<byte>(i >> j & 1);
+		}
+	}
+	return spread;
+}();
+
+/**
+ * Draws the screen into `pixels`, get_rgba_image_size(scale) bytes of RGBA
+ * image with every pixel of the screen as a `scale` by `scale` square.
+ *
+ * Lines are put together from the colors of 4 pixels at a time, looked up in
+ * a table made for the palette, and lines after the first of every square are
+ * copies.
+ */
+void render_rgba(const Frame_buffer& frame_buffer, const Palette& palette, std::size_t scale, byte* pixels)
+{
+	std::uint32_t on, off;
+	std::memcpy(&on, &palette.on, sizeof(on));
+	std::memcpy(&off, &palette.off, sizeof(off));
+
+	constexpr std::size_t PIXELS_PER_LOOKUP = 4;
+	std::array<std::array<std::uint32_t, PIXELS_PER_LOOKUP>, 1 << PIXELS_PER_LOOKUP> lookup;
+	for (std::size_t bits = 0; bits < lookup.size(); ++bits)
+	{
+		for (std::size_t i = 0; i < PIXELS_PER_LOOKUP; ++i)
+		{
+			lookup[bits][i] = bits >> i & 1 ? on : off;
+		}
+	}
+
+	const auto line_size = FRAME_BUFFER_WIDTH * scale * RGBA_BYTES_PER_PIXEL;
+
+	std::array<std::uint32_t, FRAME_BUFFER_WIDTH> colors;
+	for (std::size_t y = 0; y < FRAME_BUFFER_HEIGHT; ++y)
+	{
+		const auto row = frame_buffer.rows[y];
+		auto line = pixels + y * scale * line_size;
+
+		// Unscaled lines go straight into the image.
+		const auto unscaled = scale == 1 ? line : reinterpret_cast<byte*>(colors.data());
+		for (std::size_t x = 0; x < FRAME_BUFFER_WIDTH; x += PIXELS_PER_LOOKUP)
+		{
+			std::memcpy(unscaled + x * RGBA_BYTES_PER_PIXEL, lookup[row >> x & (lookup.size() - 1)].data(), sizeof(lookup[0]));
+		}
+
+		if (scale == 1)
+		{
+			continue;
+		}
+
+		auto out = line;
+		for (std::size_t x = 0; x < FRAME_BUFFER_WIDTH; ++x)
+		{
+			for (std::size_t i = 0; i < scale; ++i, out += RGBA_BYTES_PER_PIXEL)
+			{
+				std::memcpy(out, &colors[x], RGBA_BYTES_PER_PIXEL);
+			}
+		}
+
+		for (std::size_t i = 1; i < scale; ++i)
+		{
+			std::memcpy(line + i * line_size, line, line_size);
+		}
+	}
+}
+
+/**
+ * Draws the screen into `pixels`, get_mono_image_size(scale) bytes of 1-bit
+ * image in which pixels which are on are set, leftmost pixel in the most
+ * significant bit, as in PBM images and QImage::Format_Mono.
+ */
+void render_mono(const Frame_buffer& frame_buffer, std::size_t scale, byte* pixels)
+{
+	const auto line_size = get_mono_bytes_per_line(scale);
+
+	for (std::size_t y = 0; y < FRAME_BUFFER_HEIGHT; ++y)
+	{
+		const auto row = frame_buffer.rows[y];
+
+		auto line = pixels + y * scale * line_size;
+		if (scale == 1)
+		{
+			for (std::size_t i = 0; i < line_size; ++i)
+			{
+				line[i] = REVERSED_BYTES[row >> (i * BITS_PER_BYTE) & 0xFF];
+			}
+		}
+		else
+		{
+			// A line is a whole number of bytes, so none are left over.
+			auto out = line;
+			unsigned bits = 0;
+			std::size_t num_bits = 0;
+			for (std::size_t x = 0; x < FRAME_BUFFER_WIDTH; ++x)
+			{
+				const auto pixel = static_cast<unsigned>(row >> x & 1);
+				for (std::size_t i = 0; i < scale; ++i)
+				{
+					bits = bits << 1 | pixel;
+					if (++num_bits == BITS_PER_BYTE)
+					{
+						*out++ = static_cast<byte>(bits);
+						bits = 0;
+						num_bits = 0;
+					}
+				}
+			}
+		}
+
+		for (std::size_t i = 1; i < scale; ++i)
+		{
+			std::memcpy(line + i * line_size, line, line_size);
+		}
+	}
+}
+
+/**
+ * Draws the screen into `pixels`, BYTE_IMAGE_SIZE bytes with one per pixel:
+ * 1 if it is on, 0 if it is off.
+ */
+void render_bytes(const Frame_buffer& frame_buffer, byte* pixels)
+{
+	for (std::size_t y = 0; y < FRAME_BUFFER_HEIGHT; ++y)
+	{
+		const auto row = frame_buffer.rows[y];
+		for (std::size_t x = 0; x < FRAME_BUFFER_WIDTH; x += BITS_PER_BYTE, pixels += BITS_PER_BYTE)
+		{
+			std::memcpy(pixels, SPREAD_BYTES[row >> x & 0xFF].data(), BITS_PER_BYTE);
+		}
+	}
+}
\ No newline at end of file
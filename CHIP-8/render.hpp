@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+
+/**
+ * A color as its bytes are laid out in an RGBA image.
+ */
+struct Rgba
+{
+	byte r;
+	byte g;
+	byte b;
+	byte a;
+
+	bool operator==(const Rgba& other) const = default;
+};
+
+/**
+ * The colors of pixels which are off and on.
+ */
+struct Palette
+{
+	Rgba off;
+	Rgba on;
+};
+
+// How both frontends have always drawn the screen.
+constexpr Palette DEFAULT_PALETTE = { { 255, 255, 255, 255 }, { 0, 0, 0, 255 } };
+
+constexpr std::size_t RGBA_BYTES_PER_PIXEL = 4;
+
+constexpr std::size_t get_rgba_image_size(std::size_t scale)
+{
+	return FRAME_BUFFER_WIDTH * scale * FRAME_BUFFER_HEIGHT * scale * RGBA_BYTES_PER_PIXEL;
+}
+
+// A line of a 1-bit image is a whole number of 32-bit words for any scale,
+// which is what QImage expects.
+constexpr std::size_t get_mono_bytes_per_line(std::size_t scale)
+{
+	return FRAME_BUFFER_WIDTH * scale / BITS_PER_BYTE;
+}
+
+constexpr std::size_t get_mono_image_size(std::size_t scale)
+{
+	return get_mono_bytes_per_line(scale) * FRAME_BUFFER_HEIGHT * scale;
+}
+
+// An image with one byte per pixel, row by row, for feeding to programs
+// rather than to displays.
+constexpr std::size_t BYTE_IMAGE_SIZE = FRAME_BUFFER_WIDTH * FRAME_BUFFER_HEIGHT;
+
+void render_rgba(const Frame_buffer& frame_buffer, const Palette& palette, std::size_t scale, byte* pixels);
+void render_mono(const Frame_buffer& frame_buffer, std::size_t scale, byte* pixels);
+void render_bytes(const Frame_buffer& frame_buffer, byte* pixels);
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+
+/**
+ * A stack which holds the last `capacity` items pushed, forgetting the oldest
+ * ones once it is full. All of its memory is allocated up front, so pushing
+ * and popping never allocate.
+ */
+template <typename T>
+class Ring_buffer
+{
+public:
+	explicit Ring_buffer(std::size_t capacity)
+		: items{ nullptr }, capacity{ capacity }, end{ 0 }, count{ 0 }
+	{
+		if (capacity == 0)
+		{
+			throw std::invalid_argument{ "Ring_buffer: capacity must be at least 1" };
+		}
+
+		items = std::make_unique_for_overwrite<T[]>(capacity);
+	}
+
+	/**
+	 * Makes room for a new item on top and returns it, to be overwritten by
+	 * the caller.
+	 */
+	T& push()
+	{
+		auto& item = items[end];
+		end = (end + 1) % capacity;
+		count = count < capacity ? count + 1 : capacity;
+
+		return item;
+	}
+
+	void pop()
+	{
+		end = (end + capacity - 1) % capacity;
+		--count;
+	}
+
+	const T& top() const
+	{
+		return items[(end + capacity - 1) % capacity];
+	}
+
+	bool empty() const
+	{
+		return count == 0;
+	}
+
+	std::size_t size() const
+	{
+		return count;
+	}
+private:
+	std::unique_ptr<T[]> items;
+	std::size_t capacity;
+	std::size_t end;
+	std::size_t count;
+};
\ No newline at end of file
@@ -0,0 +1,262 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "rollback-transport.hpp"
+#include "rollback.hpp"
+#include "data-types.hpp"
+
+using std::array;
+using std::lock_guard;
+using std::mutex;
+using std::runtime_error;
+using std::string;
+
+Loopback_link::Loopback_link(size_t delay)
+	: delay{ delay }, ends{ End{ *this, 0 }, End{ *this, 1 } }
+{
+}
+
+Rollback_transport& Loopback_link::get_end(size_t player)
+{
+	return ends.at(player);
+}
+
+Loopback_link::End::End(Loopback_link& link, size_t player)
+	: link{ link }, player{ player }
+{
+}
+
+void Loopback_link::End::send(const Input_packet& packet)
+{
+	lock_guard lock{ link.mutex };
+	link.queues[1 - player].push_back(packet);
+}
+
+bool Loopback_link::End::receive(Input_packet& packet)
+{
+	lock_guard lock{ link.mutex };
+	auto& queue = link.queues[player];
+	if (queue.size() <= link.delay)
+	{
+		return false;
+	}
+
+	packet = queue.front();
+	queue.pop_front();
+	return true;
+}
+
+/**
+ * Datagrams start with PACKET_MAGIC, followed by
+ *
+ *     version               1 byte
+ *     acknowledged frames   8 bytes, little endian
+ *     first frame           8 bytes, little endian
+ *     frame count           1 byte, at most INPUT_HISTORY_SIZE
+ *     keys                  2 bytes per frame, little endian
+ *
+ * Datagrams which don't follow it are dropped.
+ */
+constexpr char PACKET_MAGIC[] = { 'C', '8', 'R', 'B' };
+constexpr byte PACKET_VERSION = 1;
+constexpr auto HEADER_SIZE = sizeof(PACKET_MAGIC) + 1 + 8 + 8 + 1;
+constexpr auto MAX_PACKET_SIZE = HEADER_SIZE + INPUT_HISTORY_SIZE * sizeof(Key_mask);
+
+static void write_le(byte*& out, std::uint64_t value, size_t size)
+{
+	for (size_t i = 0; i < size; ++i)
+	{
+		*out++ = static_cast<byte>(value >> (i * 8));
+	}
+}
+
+static std::uint64_t read_le(const byte*& in, size_t size)
+{
+	std::uint64_t value = 0;
+	for (size_t i = 0; i < size; ++i)
+	{
+		value |= std::uint64_t{ *in++ } << (i * 8);
+	}
+	return value;
+}
+
+static size_t encode_packet(const Input_packet& packet, array<byte, MAX_PACKET_SIZE>& buffer)
+{
+	auto out = buffer.data();
+	std::memcpy(out, PACKET_MAGIC, sizeof(PACKET_MAGIC));
+	out += sizeof(PACKET_MAGIC);
+
+	write_le(out, PACKET_VERSION, 1);
+	write_le(out, packet.acknowledged_frames, 8);
+	write_le(out, packet.first_frame, 8);
+	write_le(out, packet.num_frames, 1);
+	for (size_t i = 0; i < packet.num_frames; ++i)
+	{
+		write_le(out, packet.keys[i], sizeof(Key_mask));
+	}
+
+	return out - buffer.data();
+}
+
+static bool decode_packet(const array<byte, MAX_PACKET_SIZE>& buffer, size_t size, Input_packet& packet)
+{
+	if (size < HEADER_SIZE || std::memcmp(buffer.data(), PACKET_MAGIC, sizeof(PACKET_MAGIC)) != 0)
+	{
+		return false;
+	}
+
+	auto in = buffer.data() + sizeof(PACKET_MAGIC);
+	if (read_le(in, 1) != PACKET_VERSION)
+	{
+		return false;
+	}
+
+	packet.acknowledged_frames = read_le(in, 8);
+	packet.first_frame = read_le(in, 8);
+	packet.num_frames = static_cast<byte>(read_le(in, 1));
+	if (packet.num_frames > INPUT_HISTORY_SIZE || size != HEADER_SIZE + packet.num_frames * sizeof(Key_mask))
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < packet.num_frames; ++i)
+	{
+		packet.keys[i] = static_cast<Key_mask>(read_le(in, sizeof(Key_mask)));
+	}
+
+	return true;
+}
+
+#ifdef _WIN32
+using Socket = SOCKET;
+static void close_socket(Socket s)
+{
+	closesocket(s);
+	WSACleanup();
+}
+#else
+using Socket = int;
+constexpr Socket INVALID_SOCKET = -1;
+static void close_socket(Socket s)
+{
+	close(s);
+}
+#endif
+
+Udp_transport::Udp_transport(std::uint16_t local_port, const string& remote_host, std::uint16_t remote_port)
+	: remote_port{ htons(remote_port) }
+{
+#ifdef _WIN32
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+	{
+		throw runtime_error("Udp_transport: cannot start Winsock");
+	}
+#endif
+
+	addrinfo hints{};
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	addrinfo* result = nullptr;
+	if (getaddrinfo(remote_host.c_str(), nullptr, &hints, &result) != 0 || result == nullptr)
+	{
+#ifdef _WIN32
+		WSACleanup();
+#endif
+		throw runtime_error("Udp_transport: cannot resolve " + remote_host);
+	}
+	remote_address = reinterpret_cast<const sockaddr_in*>(result->ai_addr)->sin_addr.s_addr;
+	freeaddrinfo(result);
+
+	const Socket s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (s == INVALID_SOCKET)
+	{
+#ifdef _WIN32
+		WSACleanup();
+#endif
+		throw runtime_error("Udp_transport: cannot create a socket");
+	}
+
+	sockaddr_in local{};
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	local.sin_port = htons(local_port);
+
+#ifdef _WIN32
+	u_long non_blocking = 1;
+	const auto set_up = ioctlsocket(s, FIONBIO, &non_blocking) == 0;
+#else
+	const auto set_up = fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK) == 0;
+#endif
+	if (!set_up || bind(s, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) != 0)
+	{
+		close_socket(s);
+		throw runtime_error("Udp_transport: cannot bind to port " + std::to_string(local_port));
+	}
+
+	handle = static_cast<std::intptr_t>(s);
+}
+
+Udp_transport::~Udp_transport()
+{
+	close_socket(static_cast<Socket>(handle));
+}
+
+void Udp_transport::send(const Input_packet& packet)
+{
+	array<byte, MAX_PACKET_SIZE> buffer;
+	const auto size = encode_packet(packet, buffer);
+
+	sockaddr_in remote{};
+	remote.sin_family = AF_INET;
+	remote.sin_addr.s_addr = remote_address;
+	remote.sin_port = remote_port;
+
+	// Lost packets are sent again with the next one, so errors are ignored.
+	sendto(static_cast<Socket>(handle), reinterpret_cast<const char*>(buffer.data()), static_cast<int>(size), 0,
+		reinterpret_cast<const sockaddr*>(&remote), sizeof(remote));
+}
+
+bool Udp_transport::receive(Input_packet& packet)
+{
+	array<byte, MAX_PACKET_SIZE> buffer;
+	while (true)
+	{
+		const auto size = recv(static_cast<Socket>(handle), reinterpret_cast<char*>(buffer.data()), static_cast<int>(buffer.size()), 0);
+		if (size < 0)
+		{
+#ifdef _WIN32
+			// Windows reports datagrams which didn't arrive on the next receive,
+			// and fails on those which don't fit instead of cutting them short.
+			if (WSAGetLastError() == WSAECONNRESET || WSAGetLastError() == WSAEMSGSIZE)
+			{
+				continue;
+			}
+#endif
+			return false;
+		}
+
+		if (decode_packet(buffer, static_cast<size_t>(size), packet))
+		{
+			return true;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+
+#include "rollback.hpp"
+
+/**
+ * Connects two sessions in the same process, for testing. A packet is held
+ * back until its sender has sent `delay` more, which with a packet per frame
+ * simulates a latency of `delay` frames.
+ */
+class Loopback_link
+{
+public:
+	explicit Loopback_link(size_t delay = 0);
+
+	Loopback_link(const Loopback_link&) = delete;
+	Loopback_link& operator=(const Loopback_link&) = delete;
+
+	// The transport for player 0 or 1.
+	Rollback_transport& get_end(size_t player);
+private:
+	class End : public Rollback_transport
+	{
+	public:
+		End(Loopback_link& link, size_t player);
+
+		void send(const Input_packet& packet) override;
+		bool receive(Input_packet& packet) override;
+	private:
+		Loopback_link& link;
+		size_t player;
+	};
+
+	size_t delay;
+
+	// Guards the queues. `queues[i]` holds the packets sent to player i.
+	std::mutex mutex;
+	std::array<std::deque<Input_packet>, 2> queues;
+
+	std::array<End, 2> ends;
+};
+
+/**
+ * Sends packets as UDP datagrams, e.g. between two processes on localhost.
+ * Throws std::runtime_error if the socket cannot be set up.
+ */
+class Udp_transport : public Rollback_transport
+{
+public:
+	Udp_transport(std::uint16_t local_port, const std::string& remote_host, std::uint16_t remote_port);
+	~Udp_transport();
+
+	Udp_transport(const Udp_transport&) = delete;
+	Udp_transport& operator=(const Udp_transport&) = delete;
+
+	void send(const Input_packet& packet) override;
+	bool receive(Input_packet& packet) override;
+private:
+	// A SOCKET on Windows, a file descriptor elsewhere.
+	std::intptr_t handle;
+
+	// In network byte order.
+	std::uint32_t remote_address;
+	std::uint16_t remote_port;
+};
\ No newline at end of file
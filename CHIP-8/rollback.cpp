@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "rollback.hpp"
+#include "CHIP-8.hpp"
+#include "keyboard.hpp"
+#include "data-types.hpp"
+
+using std::chrono::steady_clock;
+using std::chrono::nanoseconds;
+using std::chrono::duration_cast;
+
+constexpr auto NO_ROLLBACK = UINT64_MAX;
+
+Rollback_session::Rollback_session(CHIP_8& machine, Rollback_transport& transport)
+	: machine{ machine }, transport{ transport }, frame{ 0 }, remote_frames{ 0 }, acknowledged_frames{ 0 },
+	rollback_frame{ NO_ROLLBACK }, records{}, local_keys{}, remote_keys{}, stats{}
+{
+}
+
+/**
+ * Runs the next frame with the local player holding `keys`, after correcting
+ * the frames which ran with a wrong prediction. Returns false without running
+ * it if the remote player is too far behind; call again on the next tick.
+ */
+bool Rollback_session::advance(Key_mask keys)
+{
+	receive();
+	roll_back();
+
+	// Our keys have to fit in a packet along with those the remote player
+	// hasn't acknowledged yet.
+	const auto can_advance = frame < remote_frames + MAX_ROLLBACK_FRAMES
+		&& frame < acknowledged_frames + INPUT_HISTORY_SIZE;
+	if (can_advance)
+	{
+		local_keys[frame % INPUT_HISTORY_SIZE] = keys;
+		run_frame(frame);
+		++frame;
+	}
+	else
+	{
+		++stats.stalls;
+	}
+
+	send();
+	return can_advance;
+}
+
+/**
+ * Takes in the remote player's keys and corrects the frames they show were
+ * predicted wrong, without running a new frame.
+ */
+void Rollback_session::poll()
+{
+	receive();
+	roll_back();
+	send();
+}
+
+std::uint64_t Rollback_session::get_frame() const
+{
+	return frame;
+}
+
+/**
+ * The number of frames which ran with the keys of both players known, and
+ * will never be rolled back.
+ */
+std::uint64_t Rollback_session::get_confirmed_frame() const
+{
+	return std::min(frame, remote_frames);
+}
+
+const Rollback_stats& Rollback_session::get_stats() const
+{
+	return stats;
+}
+
+void Rollback_session::receive()
+{
+	Input_packet packet;
+	while (transport.receive(packet))
+	{
+		acknowledged_frames = std::min(std::max(acknowledged_frames, packet.acknowledged_frames), frame);
+
+		// Keys after a gap wait until the gap is sent again, and keys too far
+		// ahead until there is room for them.
+		if (packet.first_frame > remote_frames)
+		{
+			continue;
+		}
+
+		const auto end = std::min<std::uint64_t>(packet.first_frame + packet.num_frames, frame + MAX_ROLLBACK_FRAMES);
+		for (; remote_frames < end; ++remote_frames)
+		{
+			const auto keys = packet.keys[remote_frames - packet.first_frame];
+			remote_keys[remote_frames % INPUT_HISTORY_SIZE] = keys;
+
+			if (remote_frames < frame && records[remote_frames % MAX_ROLLBACK_FRAMES].remote_keys != keys)
+			{
+				rollback_frame = std::min(rollback_frame, remote_frames);
+			}
+		}
+	}
+}
+
+/**
+ * Sends our keys from the first frame the remote player doesn't have.
+ */
+void Rollback_session::send()
+{
+	Input_packet packet;
+	packet.acknowledged_frames = remote_frames;
+	packet.first_frame = acknowledged_frames;
+	packet.num_frames = static_cast<byte>(std::min<std::uint64_t>(frame - acknowledged_frames, INPUT_HISTORY_SIZE));
+	for (size_t i = 0; i < packet.num_frames; ++i)
+	{
+		packet.keys[i] = local_keys[(packet.first_frame + i) % INPUT_HISTORY_SIZE];
+	}
+
+	transport.send(packet);
+}
+
+void Rollback_session::roll_back()
+{
+	if (rollback_frame == NO_ROLLBACK)
+	{
+		return;
+	}
+
+	const auto start = steady_clock::now();
+
+	const auto& record = records[rollback_frame % MAX_ROLLBACK_FRAMES];
+	machine.restore_snapshot(record.snapshot);
+	machine.keyboard = record.keyboard;
+	for (auto f = rollback_frame; f < frame; ++f)
+	{
+		run_frame(f);
+	}
+
+	const auto time = duration_cast<nanoseconds>(steady_clock::now() - start);
+	const auto num_frames = frame - rollback_frame;
+
+	++stats.rollbacks;
+	stats.frames_resimulated += num_frames;
+	stats.max_frames_resimulated = std::max(stats.max_frames_resimulated, num_frames);
+	stats.resimulation_time += time;
+	stats.max_resimulation_time = std::max(stats.max_resimulation_time, time);
+
+	rollback_frame = NO_ROLLBACK;
+}
+
+/**
+ * Runs `frame` with the keys known for it, or predicted, and records what is
+ * needed to run it again.
+ */
+void Rollback_session::run_frame(std::uint64_t frame)
+{
+	auto& record = records[frame % MAX_ROLLBACK_FRAMES];
+	record.snapshot = machine.take_snapshot();
+	record.keyboard = machine.keyboard;
+	record.remote_keys = frame < remote_frames ? remote_keys[frame % INPUT_HISTORY_SIZE] : predict_remote_keys();
+
+	machine.keyboard.set_pressed_keys(local_keys[frame % INPUT_HISTORY_SIZE] | record.remote_keys);
+	machine.run_frames(1);
+}
+
+Key_mask Rollback_session::predict_remote_keys() const
+{
+	return remote_frames > 0 ? remote_keys[(remote_frames - 1) % INPUT_HISTORY_SIZE] : 0;
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "CHIP-8.hpp"
+#include "keyboard.hpp"
+#include "data-types.hpp"
+
+// How many frames a session may run on predicted input before it waits for
+// the remote player.
+constexpr auto MAX_ROLLBACK_FRAMES = 8;
+
+// Inputs are kept for twice as many frames, since the remote player can be
+// that far ahead of what it knows we received.
+constexpr auto INPUT_HISTORY_SIZE = 2 * MAX_ROLLBACK_FRAMES;
+
+/**
+ * What two Rollback_sessions send each other: the sender's keys for
+ * `num_frames` frames starting at `first_frame`, and how many frames of the
+ * receiver's keys the sender has.
+ */
+struct Input_packet
+{
+	std::uint64_t acknowledged_frames;
+	std::uint64_t first_frame;
+	byte num_frames;
+	std::array<Key_mask, INPUT_HISTORY_SIZE> keys;
+};
+
+/**
+ * Carries Input_packets between two sessions. Packets may be lost, delayed or
+ * reordered: sessions send their keys again until they are acknowledged.
+ */
+class Rollback_transport
+{
+public:
+	virtual ~Rollback_transport() = default;
+
+	virtual void send(const Input_packet& packet) = 0;
+
+	// Never waits. Returns false if no packet has arrived.
+	virtual bool receive(Input_packet& packet) = 0;
+};
+
+struct Rollback_stats
+{
+	// Times a prediction of the remote player's keys turned out wrong, and
+	// the frames which were run again because of it.
+	std::uint64_t rollbacks;
+	std::uint64_t frames_resimulated;
+	std::uint64_t max_frames_resimulated;
+
+	std::chrono::nanoseconds resimulation_time;
+	std::chrono::nanoseconds max_resimulation_time;
+
+	// Calls to advance which ran nothing, because the remote player's keys
+	// were too far behind.
+	std::uint64_t stalls;
+};
+
+/**
+ * One side of a two-player game on a single keypad, played over a transport.
+ * Both sides run the same program; the machine sees the keys of both players
+ * together.
+ *
+ * Every frame runs right away with the local player's keys and a prediction
+ * of the remote player's: whatever they held last. When their actual keys
+ * arrive and differ, the session goes back to the first frame it got wrong
+ * and runs again up to the present before the next frame, so both sides end
+ * up with the same machine.
+ *
+ * Load the same program into both machines before creating the sessions, and
+ * from then on only run them through advance and poll.
+ */
+class Rollback_session
+{
+public:
+	Rollback_session(CHIP_8& machine, Rollback_transport& transport);
+
+	bool advance(Key_mask keys);
+	void poll();
+
+	std::uint64_t get_frame() const;
+	std::uint64_t get_confirmed_frame() const;
+	const Rollback_stats& get_stats() const;
+private:
+	// What is needed to run a frame again. Snapshots of nearby frames share
+	// the memory pages neither of them wrote.
+	struct Frame_record
+	{
+		CHIP_8::Snapshot snapshot;
+		Keyboard keyboard;
+		Key_mask remote_keys;
+	};
+
+	void receive();
+	void send();
+	void roll_back();
+	void run_frame(std::uint64_t frame);
+	Key_mask predict_remote_keys() const;
+
+	CHIP_8& machine;
+	Rollback_transport& transport;
+
+	// Frames run so far.
+	std::uint64_t frame;
+
+	// Frames of the remote player's keys received, and of ours it has.
+	std::uint64_t remote_frames;
+	std::uint64_t acknowledged_frames;
+
+	// The first frame which ran with a wrong prediction, or NO_ROLLBACK.
+	std::uint64_t rollback_frame;
+
+	// Indexed by frame number, modulo their size. Records are kept for the
+	// frames which may still be rolled back.
+	std::array<Frame_record, MAX_ROLLBACK_FRAMES> records;
+	std::array<Key_mask, INPUT_HISTORY_SIZE> local_keys;
+	std::array<Key_mask, INPUT_HISTORY_SIZE> remote_keys;
+
+	Rollback_stats stats;
+};
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include <cstddef>
+#include <cstdint>
+
+#include "run-ahead.hpp"
+#include "CHIP-8.hpp"
+#include "data-types.hpp"
+
+Run_ahead::Run_ahead(CHIP_8& machine, size_t frames)
+	: machine{ machine }, frames{ frames }, frame_buffer{}, cycle{ UINT64_MAX }
+{
+}
+
+/**
+ * Runs ahead from where the machine is now, which is usually right after a
+ * frame. Returns whether the screen to display changed.
+ */
+bool Run_ahead::update()
+{
+	if (frames == 0)
+	{
+		return false;
+	}
+
+	// The machine has already moved on, so its own screen is not the one on
+	// display.
+	const auto previous_frame_buffer = frame_buffer;
+
+	{
+		const auto snapshot = machine.take_snapshot();
+		machine.run_frames(frames);
+		frame_buffer = machine.frame_buffer;
+		machine.restore_snapshot(snapshot);
+	}
+
+	cycle = machine.cycles;
+	return frame_buffer != previous_frame_buffer;
+}
+
+void Run_ahead::set_frames(size_t frames)
+{
+	this->frames = frames;
+}
+
+size_t Run_ahead::get_frames() const
+{
+	return frames;
+}
+
+/**
+ * The screen to display: the one from running ahead, unless the machine has
+ * moved on since (e.g. the debugger stepped it), in which case its own screen.
+ */
+const Frame_buffer& Run_ahead::get_frame_buffer() const
+{
+	if (frames == 0 || machine.cycles != cycle)
+	{
+		return machine.frame_buffer;
+	}
+
+	return frame_buffer;
+}
\ No newline at end of file
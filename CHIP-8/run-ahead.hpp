@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "CHIP-8.hpp"
+#include "data-types.hpp"
+
+/**
+ * Hides the frames a program takes to react to input. After every frame the
+ * host runs, the machine is run some frames further with the keys as they are
+ * now, the screen it ends up with is kept for display, and the machine is put
+ * back the way it was. The frames run ahead leave no trace in the machine, so
+ * debugging, recording and publishing see the real frames.
+ *
+ * The machine is put back from a snapshot, which only copies the pages the
+ * frames run ahead wrote. The snapshot is dropped right away, so that the
+ * next one can reuse its pages instead of allocating.
+ */
+class Run_ahead
+{
+public:
+	Run_ahead(CHIP_8& machine, size_t frames);
+
+	bool update();
+
+	void set_frames(size_t frames);
+	size_t get_frames() const;
+
+	const Frame_buffer& get_frame_buffer() const;
+private:
+	CHIP_8& machine;
+	size_t frames;
+
+	// The screen `frames` frames after cycle `cycle`.
+	Frame_buffer frame_buffer;
+	std::uint64_t cycle;
+};
\ No newline at end of file
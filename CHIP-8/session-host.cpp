@@ -0,0 +1,356 @@
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <stdexcept>
+
+#include "session-host.hpp"
+#include "CHIP-8.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+#include "keyboard.hpp"
+
+using std::chrono::steady_clock;
+using std::chrono::nanoseconds;
+using std::lock_guard;
+using std::unique_lock;
+using std::make_shared;
+using std::shared_ptr;
+using std::out_of_range;
+using std::memory_order_relaxed;
+
+Session_host::Session_host(size_t num_workers, size_t instructions_per_frame)
+	: instructions_per_frame{ instructions_per_frame }, queues(num_workers > 0 ? num_workers : 1),
+	num_pending_tasks{ 0 }, running{ false }
+{
+}
+
+Session_host::~Session_host()
+{
+	stop();
+}
+
+Session_id Session_host::add_session(CHIP_8& machine)
+{
+	lock_guard<std::mutex> lock{ sessions_mutex };
+
+	Session_id id = 0;
+	while (id < sessions.size() && sessions[id])
+	{
+		++id;
+	}
+	if (id == sessions.size())
+	{
+		sessions.emplace_back();
+	}
+
+	auto session = make_shared<Session>();
+	session->id = id;
+	session->machine = &machine;
+	session->status = Run_status::RUNNING;
+	session->scheduled = false;
+	session->frames = 0;
+	session->deadlines_missed = 0;
+	session->frames_skipped = 0;
+
+	sessions[id] = std::move(session);
+	return id;
+}
+
+/**
+ * Waits for the session's pending frame, if any, and for calls which are using
+ * its machine. Afterwards the machine can be used directly again.
+ */
+void Session_host::remove_session(Session_id id)
+{
+	shared_ptr<Session> session;
+	{
+		lock_guard<std::mutex> lock{ sessions_mutex };
+		if (id >= sessions.size() || !sessions[id])
+		{
+			throw out_of_range{ "No such session" };
+		}
+
+		session = std::move(sessions[id]);
+	}
+
+	// The scheduler can't queue the session anymore, and a stopped host drops
+	// its queued tasks, so this ends.
+	while (session->scheduled)
+	{
+		std::this_thread::yield();
+	}
+
+	lock_guard<std::mutex> lock{ session->mutex };
+	session->machine = nullptr;
+}
+
+size_t Session_host::get_num_sessions() const
+{
+	lock_guard<std::mutex> lock{ sessions_mutex };
+
+	size_t num_sessions = 0;
+	for (const auto& session : sessions)
+	{
+		num_sessions += session != nullptr;
+	}
+
+	return num_sessions;
+}
+
+void Session_host::start()
+{
+	lock_guard<std::mutex> lock{ wake_mutex };
+	if (running)
+	{
+		return;
+	}
+
+	running = true;
+	for (size_t i = 0; i < queues.size(); ++i)
+	{
+		workers.emplace_back(&Session_host::work, this, i);
+	}
+	scheduler = std::thread{ &Session_host::schedule, this };
+}
+
+void Session_host::stop()
+{
+	{
+		lock_guard<std::mutex> lock{ wake_mutex };
+		running = false;
+	}
+	wake_up.notify_all();
+
+	if (scheduler.joinable())
+	{
+		scheduler.join();
+	}
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+	workers.clear();
+
+	// Frames which were queued but never ran are dropped.
+	for (auto& queue : queues)
+	{
+		lock_guard<std::mutex> lock{ queue.mutex };
+		for (auto session : queue.tasks)
+		{
+			session->scheduled = false;
+		}
+		queue.tasks.clear();
+	}
+	num_pending_tasks = 0;
+}
+
+bool Session_host::is_running() const
+{
+	lock_guard<std::mutex> lock{ wake_mutex };
+	return running;
+}
+
+void Session_host::set_key_pressed(Session_id id, Key k)
+{
+	const auto session = get_session(id);
+	lock_guard<std::mutex> lock{ session->mutex };
+	get_machine(*session).keyboard.set_key_pressed(k);
+}
+
+void Session_host::set_key_released(Session_id id, Key k)
+{
+	const auto session = get_session(id);
+	lock_guard<std::mutex> lock{ session->mutex };
+	get_machine(*session).keyboard.set_key_released(k);
+}
+
+Frame_buffer Session_host::get_frame_buffer(Session_id id) const
+{
+	const auto session = get_session(id);
+	lock_guard<std::mutex> lock{ session->mutex };
+	return get_machine(*session).get_frame_buffer();
+}
+
+Session_stats Session_host::get_stats(Session_id id) const
+{
+	const auto session = get_session(id);
+	lock_guard<std::mutex> lock{ session->mutex };
+	return Session_stats{
+		session->frames.load(memory_order_relaxed),
+		session->deadlines_missed.load(memory_order_relaxed),
+		session->frames_skipped.load(memory_order_relaxed),
+		session->status,
+	};
+}
+
+void Session_host::on_deadline_missed(Deadline_callback callback)
+{
+	deadline_callback = std::move(callback);
+}
+
+/**
+ * Queues a frame of every session once per tick. A session whose previous
+ * frame is still pending skips this one.
+ */
+void Session_host::schedule()
+{
+	constexpr nanoseconds tick_period{ NANOSECONDS_PER_REFRESH };
+
+	auto next_tick = steady_clock::now();
+
+	unique_lock<std::mutex> wake_lock{ wake_mutex };
+	while (running)
+	{
+		wake_lock.unlock();
+
+		const auto deadline = next_tick + tick_period;
+		{
+			lock_guard<std::mutex> lock{ sessions_mutex };
+			for (const auto& session : sessions)
+			{
+				if (!session)
+				{
+					continue;
+				}
+
+				if (session->scheduled.exchange(true))
+				{
+					session->frames_skipped.fetch_add(1, memory_order_relaxed);
+					continue;
+				}
+
+				// Sessions stay on the same worker from tick to tick, unless stolen.
+				// A task is counted before a worker can take it, so that the
+				// count never drops below the tasks actually queued.
+				auto& queue = queues[session->id % queues.size()];
+				lock_guard<std::mutex> queue_lock{ queue.mutex };
+				session->deadline = deadline;
+				++num_pending_tasks;
+				queue.tasks.push_back(session.get());
+			}
+		}
+
+		// Workers check for tasks with wake_mutex held, so none of them can
+		// miss this.
+		wake_lock.lock();
+		wake_up.notify_all();
+
+		// A scheduler which overslept doesn't try to catch up, the sessions
+		// already skipped those frames.
+		next_tick = deadline;
+		if (const auto now = steady_clock::now(); now - next_tick > tick_period)
+		{
+			next_tick = now;
+		}
+
+		wake_up.wait_until(wake_lock, next_tick, [this] { return !running; });
+	}
+}
+
+void Session_host::work(size_t worker)
+{
+	while (true)
+	{
+		if (auto session = take_task(worker))
+		{
+			run_frame(*session);
+			continue;
+		}
+
+		unique_lock<std::mutex> lock{ wake_mutex };
+		wake_up.wait(lock, [this] { return !running || num_pending_tasks > 0; });
+		if (!running)
+		{
+			return;
+		}
+	}
+}
+
+/**
+ * Takes the newest task of the worker's own queue, or else the oldest task of
+ * another worker's queue.
+ */
+Session_host::Session* Session_host::take_task(size_t worker)
+{
+	for (size_t i = 0; i < queues.size(); ++i)
+	{
+		const auto is_own_queue = i == 0;
+		auto& queue = queues[(worker + i) % queues.size()];
+
+		lock_guard<std::mutex> lock{ queue.mutex };
+		if (queue.tasks.empty())
+		{
+			continue;
+		}
+
+		Session* session = nullptr;
+		if (is_own_queue)
+		{
+			session = queue.tasks.back();
+			queue.tasks.pop_back();
+		}
+		else
+		{
+			session = queue.tasks.front();
+			queue.tasks.pop_front();
+		}
+
+		--num_pending_tasks;
+		return session;
+	}
+
+	return nullptr;
+}
+
+void Session_host::run_frame(Session& session)
+{
+	{
+		lock_guard<std::mutex> lock{ session.mutex };
+		session.status = session.machine->run(instructions_per_frame).status;
+	}
+	session.frames.fetch_add(1, memory_order_relaxed);
+
+	const auto lateness = steady_clock::now() - session.deadline;
+	const auto id = session.id;
+	const auto is_late = lateness > nanoseconds::zero();
+	if (is_late)
+	{
+		session.deadlines_missed.fetch_add(1, memory_order_relaxed);
+	}
+
+	// The session may be removed as soon as it isn't scheduled anymore.
+	session.scheduled = false;
+
+	if (is_late && deadline_callback)
+	{
+		deadline_callback(id, lateness);
+	}
+}
+
+shared_ptr<Session_host::Session> Session_host::get_session(Session_id id) const
+{
+	lock_guard<std::mutex> lock{ sessions_mutex };
+	if (id >= sessions.size() || !sessions[id])
+	{
+		throw out_of_range{ "No such session" };
+	}
+
+	return sessions[id];
+}
+
+/**
+ * The session's machine, for calls which hold the session's mutex. A session
+ * removed since it was found has none.
+ */
+CHIP_8& Session_host::get_machine(const Session& session)
+{
+	if (session.machine == nullptr)
+	{
+		throw out_of_range{ "No such session" };
+	}
+
+	return *session.machine;
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "CHIP-8.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+#include "keyboard.hpp"
+
+using Session_id = std::size_t;
+
+struct Session_stats
+{
+	std::uint64_t frames;
+
+	// Frames which finished after their deadline.
+	std::uint64_t deadlines_missed;
+
+	// Frames which never ran because the previous one was still pending.
+	std::uint64_t frames_skipped;
+
+	Run_status status;
+};
+
+/**
+ * Hosts many machines ("sessions") on a fixed pool of worker threads.
+ *
+ * Every NANOSECONDS_PER_REFRESH, each session gets a task which runs one frame
+ * of it, due by the next tick. Tasks are queued on the worker the session is
+ * pinned to; a worker which runs out of tasks steals from the others, so a few
+ * slow sessions don't hold up the rest.
+ *
+ * Like with Frame_runner, a machine which is added to a host must only be
+ * accessed through it until it is removed.
+ */
+class Session_host
+{
+public:
+	using Deadline_callback = std::function<void(Session_id id, std::chrono::nanoseconds lateness)>;
+
+	explicit Session_host(size_t num_workers = std::thread::hardware_concurrency(),
+		size_t instructions_per_frame = INSTRUCTIONS_PER_REFRESH);
+	~Session_host();
+
+	Session_host(const Session_host&) = delete;
+	Session_host& operator=(const Session_host&) = delete;
+
+	Session_id add_session(CHIP_8& machine);
+	void remove_session(Session_id id);
+	size_t get_num_sessions() const;
+
+	void start();
+	void stop();
+	bool is_running() const;
+
+	void set_key_pressed(Session_id id, Key k);
+	void set_key_released(Session_id id, Key k);
+
+	Frame_buffer get_frame_buffer(Session_id id) const;
+	Session_stats get_stats(Session_id id) const;
+
+	// Called from the worker threads, so it must be set before starting.
+	void on_deadline_missed(Deadline_callback callback);
+private:
+	struct Session
+	{
+		Session_id id;
+		CHIP_8* machine;
+
+		// Guards the machine and status. The machine is null once the session
+		// has been removed.
+		mutable std::mutex mutex;
+		Run_status status;
+
+		// Set while a task for the session is queued or running.
+		std::atomic<bool> scheduled;
+		std::chrono::steady_clock::time_point deadline;
+
+		std::atomic<std::uint64_t> frames;
+		std::atomic<std::uint64_t> deadlines_missed;
+		std::atomic<std::uint64_t> frames_skipped;
+	};
+
+	struct Worker_queue
+	{
+		std::mutex mutex;
+		std::deque<Session*> tasks;
+	};
+
+	void schedule();
+	void work(size_t worker);
+	Session* take_task(size_t worker);
+	void run_frame(Session& session);
+	std::shared_ptr<Session> get_session(Session_id id) const;
+	static CHIP_8& get_machine(const Session& session);
+
+	size_t instructions_per_frame;
+	Deadline_callback deadline_callback;
+
+	// Guards the list of sessions. Removed sessions leave an empty slot behind,
+	// which is reused for the next new session. Calls which found a session
+	// before it was removed keep it alive until they return.
+	mutable std::mutex sessions_mutex;
+	std::vector<std::shared_ptr<Session>> sessions;
+
+	std::vector<Worker_queue> queues;
+	std::atomic<size_t> num_pending_tasks;
+
+	// Guards running and wakes up the workers and the scheduler.
+	mutable std::mutex wake_mutex;
+	std::condition_variable wake_up;
+	bool running;
+
+	std::thread scheduler;
+	std::vector<std::thread> workers;
+};
\ No newline at end of file
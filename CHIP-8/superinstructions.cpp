@@ -0,0 +1,213 @@
+#include <cstddef>
+#include <cstdint>
+
+#include "superinstructions.hpp"
+#include "CHIP-8.hpp"
+#include "helpers.hpp"
+#include "machine-specs.hpp"
+#include "data-types.hpp"
+
+static byte get_category(instruction_t ins)
+{
+	return ins >> 12;
+}
+
+Superinstructions::Superinstructions(CHIP_8& machine)
+	: machine{ machine }
+{
+}
+
+size_t Superinstructions::run(size_t budget)
+{
+	const auto pc = machine.pc;
+	if (pc >= MEMORY_SIZE || budget < 2)
+	{
+		return 0;
+	}
+
+	const auto page = pc / PAGE_SIZE;
+	const auto page_bit = std::uint64_t{ 1 } << page;
+	if (!(machine.idiom_pages & page_bit))
+	{
+		find_idioms(page);
+	}
+
+	// Programs run from even addresses, so only those are searched.
+	if (pc % INSTRUCTION_SIZE != 0 || !(machine.idiom_starts[page] >> (pc % PAGE_SIZE / INSTRUCTION_SIZE) & 1))
+	{
+		return 0;
+	}
+
+	size_t executed = 0;
+	switch (get_category(fetch(pc, MEMORY_SIZE)))
+	{
+	case 0x6:
+		executed = run_loads(budget, (page + 1) * PAGE_SIZE);
+		break;
+	case 0x7:
+		executed = run_loop_counter(budget);
+		break;
+	case 0xA:
+		executed = run_draw();
+		break;
+	case 0xF:
+		executed = run_load_registers();
+		break;
+	}
+
+	machine.cycles += executed;
+	return executed;
+}
+
+void Superinstructions::find_idioms(size_t page)
+{
+	const auto page_start = page * PAGE_SIZE;
+	const auto page_end = page_start + PAGE_SIZE;
+
+	std::uint32_t starts = 0;
+	for (size_t offset = 0; offset < PAGE_SIZE; offset += INSTRUCTION_SIZE)
+	{
+		if (is_idiom_start(page_start + offset, page_end))
+		{
+			starts |= std::uint32_t{ 1 } << offset / INSTRUCTION_SIZE;
+		}
+	}
+
+	machine.idiom_starts[page] = starts;
+	machine.idiom_pages |= std::uint64_t{ 1 } << page;
+}
+
+/**
+ * Only considers instructions which lie entirely before `page_end`.
+ */
+bool Superinstructions::is_idiom_start(size_t address, size_t page_end) const
+{
+	const auto first = fetch(address, page_end);
+	const auto second = fetch(address + INSTRUCTION_SIZE, page_end);
+
+	switch (get_category(first))
+	{
+	case 0x6:
+		return get_category(second) == 0x6;
+	case 0x7:
+	{
+		const auto third = fetch(address + 2 * INSTRUCTION_SIZE, page_end);
+		return (get_category(second) == 0x3 || get_category(second) == 0x4) && get_category(third) == 0x1;
+	}
+	case 0xA:
+		return get_category(second) == 0xD;
+	case 0xF:
+		return (first & 0x00FF) == 0x1E && (second & 0xF0FF) == 0xF065;
+	default:
+		return false;
+	}
+}
+
+/**
+ * Returns the instruction at `address`, or 0x0000, which starts no idiom, if
+ * the instruction doesn't end before `page_end`.
+ */
+instruction_t Superinstructions::fetch(size_t address, size_t page_end) const
+{
+	if (address + 1 >= page_end)
+	{
+		return 0;
+	}
+
+	return concatenate_bytes(machine.memory[address], machine.memory[address + 1]);
+}
+
+/**
+ * 6xNN, 6xNN, ... for as long as the page and the budget last.
+ */
+size_t Superinstructions::run_loads(size_t budget, size_t page_end)
+{
+	size_t executed = 0;
+	for (auto ins = fetch(machine.pc, page_end); executed < budget && get_category(ins) == 0x6;
+		ins = fetch(machine.pc, page_end))
+	{
+		machine.registers[(ins >> 8) & 0xF] = ins & 0xFF;
+		machine.pc += INSTRUCTION_SIZE;
+		++executed;
+	}
+
+	return executed;
+}
+
+/**
+ * 7xNN, then 3yKK or 4yKK, then 1NNN. The jump is skipped if the condition
+ * holds.
+ */
+size_t Superinstructions::run_loop_counter(size_t budget)
+{
+	if (budget < 3)
+	{
+		return 0;
+	}
+
+	const auto pc = machine.pc;
+	const auto add = fetch(pc, MEMORY_SIZE);
+	const auto skip = fetch(pc + INSTRUCTION_SIZE, MEMORY_SIZE);
+	const auto jump = fetch(pc + 2 * INSTRUCTION_SIZE, MEMORY_SIZE);
+
+	machine.registers[(add >> 8) & 0xF] += add & 0xFF;
+
+	const auto is_equal = machine.registers[(skip >> 8) & 0xF] == (skip & 0xFF);
+	if (is_equal == (get_category(skip) == 0x3))
+	{
+		machine.pc = pc + 3 * INSTRUCTION_SIZE;
+		return 2;
+	}
+
+	machine.pc = jump & 0x0FFF;
+	return 3;
+}
+
+/**
+ * Annn, then Dxyn.
+ */
+size_t Superinstructions::run_draw()
+{
+	const auto pc = machine.pc;
+	const auto set_index = fetch(pc, MEMORY_SIZE);
+	const auto draw = fetch(pc + INSTRUCTION_SIZE, MEMORY_SIZE);
+
+	machine.index_register = set_index & 0x0FFF;
+
+	const auto x = machine.registers[(draw >> 8) & 0xF];
+	const auto y = machine.registers[(draw >> 4) & 0xF];
+
+	byte vf_flag_val = 0;
+	for (size_t i = 0; i < (draw & 0xF); ++i)
+	{
+		if (machine.frame_buffer.draw_sprite_row(x, y + i, machine.read_memory(machine.index_register + i)))
+		{
+			vf_flag_val = 1;
+		}
+	}
+	machine.registers[0xF] = vf_flag_val;
+
+	machine.pc = pc + 2 * INSTRUCTION_SIZE;
+	return 2;
+}
+
+/**
+ * Fx1E, then Fy65.
+ */
+size_t Superinstructions::run_load_registers()
+{
+	const auto pc = machine.pc;
+	const auto add = fetch(pc, MEMORY_SIZE);
+	const auto load = fetch(pc + INSTRUCTION_SIZE, MEMORY_SIZE);
+
+	const size_t last_register = (load >> 8) & 0xF;
+	const double_byte start = machine.index_register + machine.registers[(add >> 8) & 0xF];
+	for (size_t i = 0; i <= last_register; ++i)
+	{
+		machine.registers[i] = machine.read_memory(start + i);
+	}
+	machine.index_register = static_cast<double_byte>(start + last_register + 1);
+
+	machine.pc = pc + 2 * INSTRUCTION_SIZE;
+	return 2;
+}
\ No newline at end of file
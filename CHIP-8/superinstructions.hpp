@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+
+#include "data-types.hpp"
+
+class CHIP_8;
+
+/**
+ * Runs common idioms of several instructions in one step ("superinstructions"),
+ * which saves fetching, decoding and dispatching each of them separately:
+ *
+ * - runs of 6xNN register loads,
+ * - Annn followed by Dxyn,
+ * - 7xNN, 3yNN or 4yNN, 1NNN loop counters,
+ * - Fx1E followed by Fy65.
+ *
+ * Idioms are found a memory page at a time, the first time the machine runs
+ * code in the page, and only within a page and at even addresses, where
+ * programs run from. A write to the page makes the
+ * machine forget its idioms until the page is searched again. An idiom is only
+ * run if it can't fault and fits in the instruction budget; otherwise the
+ * interpreter takes it one instruction at a time, so the result is always the
+ * same as without superinstructions.
+ *
+ * Like Executor, a Superinstructions is only a reference to the machine and the
+ * machine makes one whenever it needs one.
+ */
+class Superinstructions
+{
+public:
+	explicit Superinstructions(CHIP_8& machine);
+
+	// Returns the number of instructions executed, or 0 if no idiom starts at
+	// pc.
+	size_t run(size_t budget);
+private:
+	CHIP_8& machine;
+
+	void find_idioms(size_t page);
+	bool is_idiom_start(size_t address, size_t page_end) const;
+	instruction_t fetch(size_t address, size_t page_end) const;
+
+	size_t run_loads(size_t budget, size_t page_end);
+	size_t run_loop_counter(size_t budget);
+	size_t run_draw();
+	size_t run_load_registers();
+};
\ No newline at end of file
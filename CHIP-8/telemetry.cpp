@@ -0,0 +1,64 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "telemetry.hpp"
+
+using std::chrono::steady_clock;
+using std::chrono::nanoseconds;
+using std::chrono::seconds;
+using std::chrono::duration;
+using std::memory_order_relaxed;
+
+Telemetry::Telemetry()
+	: instructions_executed{ 0 }, instructions_per_second{ 0 }, frames_produced{ 0 }, frames_skipped{ 0 },
+	timer_ticks_missed{ 0 }, execute_nanoseconds{ 0 }, render_nanoseconds{ 0 },
+	window_start{ steady_clock::now() }, window_instructions{ 0 }
+{
+}
+
+void Telemetry::add_execution(std::uint64_t instructions, nanoseconds time)
+{
+	instructions_executed.fetch_add(instructions, memory_order_relaxed);
+	execute_nanoseconds.fetch_add(time.count(), memory_order_relaxed);
+
+	window_instructions += instructions;
+
+	const auto now = steady_clock::now();
+	const duration<double> window = now - window_start;
+	if (window >= seconds{ 1 })
+	{
+		instructions_per_second.store(window_instructions / window.count(), memory_order_relaxed);
+		window_start = now;
+		window_instructions = 0;
+	}
+}
+
+void Telemetry::add_render(nanoseconds time)
+{
+	render_nanoseconds.fetch_add(time.count(), memory_order_relaxed);
+}
+
+void Telemetry::add_frames(std::uint64_t produced, std::uint64_t skipped)
+{
+	frames_produced.fetch_add(produced, memory_order_relaxed);
+	frames_skipped.fetch_add(skipped, memory_order_relaxed);
+}
+
+void Telemetry::add_missed_timer_ticks(std::uint64_t ticks)
+{
+	timer_ticks_missed.fetch_add(ticks, memory_order_relaxed);
+}
+
+Telemetry_counters Telemetry::read() const
+{
+	return Telemetry_counters{
+		instructions_executed.load(memory_order_relaxed),
+		instructions_per_second.load(memory_order_relaxed),
+		frames_produced.load(memory_order_relaxed),
+		frames_skipped.load(memory_order_relaxed),
+		timer_ticks_missed.load(memory_order_relaxed),
+		nanoseconds{ execute_nanoseconds.load(memory_order_relaxed) },
+		nanoseconds{ render_nanoseconds.load(memory_order_relaxed) },
+	};
+}
\ No newline at end of file
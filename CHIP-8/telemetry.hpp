@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+struct Telemetry_counters
+{
+	std::uint64_t instructions_executed;
+
+	// Achieved speed, measured over roughly the last second.
+	double instructions_per_second;
+
+	std::uint64_t frames_produced;
+
+	// Refreshes which were dropped because the host fell too far behind.
+	std::uint64_t frames_skipped;
+
+	// Timer decrements which never reached the machine, for example those of
+	// skipped frames.
+	std::uint64_t timer_ticks_missed;
+
+	std::chrono::nanoseconds execute_time;
+	std::chrono::nanoseconds render_time;
+};
+
+/**
+ * Counters describing how well a host keeps up with its machine.
+ *
+ * The host reports what it did from the thread that runs the machine. The
+ * counters can be read at any time and from any thread without stopping it.
+ */
+class Telemetry
+{
+public:
+	Telemetry();
+
+	void add_execution(std::uint64_t instructions, std::chrono::nanoseconds time);
+	void add_render(std::chrono::nanoseconds time);
+	void add_frames(std::uint64_t produced, std::uint64_t skipped);
+	void add_missed_timer_ticks(std::uint64_t ticks);
+
+	Telemetry_counters read() const;
+private:
+	std::atomic<std::uint64_t> instructions_executed;
+	std::atomic<double> instructions_per_second;
+	std::atomic<std::uint64_t> frames_produced;
+	std::atomic<std::uint64_t> frames_skipped;
+	std::atomic<std::uint64_t> timer_ticks_missed;
+	std::atomic<std::int64_t> execute_nanoseconds;
+	std::atomic<std::int64_t> render_nanoseconds;
+
+	// The window instructions_per_second is measured over. Only used by the
+	// reporting thread.
+	std::chrono::steady_clock::time_point window_start;
+	std::uint64_t window_instructions;
+};
\ No newline at end of file
@@ -0,0 +1,487 @@
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+
+#include "translator.hpp"
+#include "CHIP-8.hpp"
+#include "helpers.hpp"
+#include "compiled-program.hpp"
+#include "machine-specs.hpp"
+#include "data-types.hpp"
+
+using std::string;
+using std::vector;
+using std::ostringstream;
+using std::hex;
+using std::uppercase;
+using std::setw;
+using std::setfill;
+using std::to_string;
+
+static const auto PRELUDE = R"(// Generated by the CHIP-8 ahead-of-time translator. Do not edit.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "addressing.hpp"
+#include "compiled-program.hpp"
+#include "font-data.hpp"
+#include "machine-specs.hpp"
+#include "data-types.hpp"
+
+#ifdef _WIN32
+#define CHIP8_EXPORT extern "C" __declspec(dllexport)
+#else
+#define CHIP8_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+static void draw(Compiled_context& ctx, byte x_register, byte y_register, byte height)
+{
+	const auto x = ctx.registers[x_register];
+	const auto y = ctx.registers[y_register];
+
+	byte vf_flag_val = 0;
+	for (std::size_t i = 0; i < height; ++i)
+	{
+		if (ctx.frame_buffer->draw_sprite_row(x, y + i, ctx.memory[wrap_address(*ctx.index_register + i)]))
+		{
+			vf_flag_val = 1;
+		}
+	}
+
+	ctx.registers[0xF] = vf_flag_val;
+}
+
+CHIP8_EXPORT int chip8_compiled_abi_version()
+{
+	return )";
+
+Translator::Translator(const CHIP_8& machine)
+	: machine{ machine }
+{
+	trace();
+}
+
+/**
+ * Returns the C++ source of a shared library which implements
+ * COMPILED_RUN_SYMBOL for the traced program.
+ */
+string Translator::translate() const
+{
+	ostringstream out;
+	out << PRELUDE << COMPILED_ABI_VERSION << ";\n}\n\n";
+
+	vector<vector<double_byte>> blocks;
+	for (size_t location = 0; location < MEMORY_SIZE; ++location)
+	{
+		if (leaders[location])
+		{
+			blocks.push_back(get_block(location));
+		}
+	}
+
+	// The original bytes of every block, used to detect self-modifying code.
+	for (const auto& block : blocks)
+	{
+		const auto start = block.front();
+		const auto end = block.back() + INSTRUCTION_SIZE;
+
+		out << "static const byte block_" << Helper::to_hex(start, 3) << "[] = {";
+		for (auto location = start; location < end; ++location)
+		{
+			out << " 0x" << Helper::to_hex(machine.memory[location], 2) << ',';
+		}
+		out << " };\n";
+	}
+
+	out << "\nCHIP8_EXPORT std::size_t " << COMPILED_RUN_SYMBOL << "(Compiled_context& ctx, std::size_t budget)\n"
+		<< "{\n"
+		<< "\tbyte* const V = ctx.registers;\n"
+		<< "\tbyte* const memory = ctx.memory;\n"
+		<< "\tdouble_byte& pc = *ctx.pc;\n"
+		<< "\tdouble_byte& I = *ctx.index_register;\n"
+		<< "\tbyte& sp = *ctx.stack_pointer;\n"
+		<< "\tstd::size_t executed = 0;\n"
+		<< "\tstatic_cast<void>(V), static_cast<void>(memory), static_cast<void>(I), static_cast<void>(sp);\n\n"
+		<< "\tfor (;;)\n"
+		<< "\t{\n"
+		<< "\t\tswitch (pc)\n"
+		<< "\t\t{\n";
+
+	// Every translated instruction is an entry point, so that execution can
+	// resume in the middle of a block after running out of budget.
+	for (const auto& block : blocks)
+	{
+		const auto start = block.front();
+		const auto end = block.back() + INSTRUCTION_SIZE;
+
+		for (const auto location : block)
+		{
+			const auto label = Helper::to_hex(location, 3);
+			out << "\t\tcase 0x" << label << ":\n"
+				<< "\t\t\tif (std::memcmp(memory + 0x" << label << ", block_" << Helper::to_hex(start, 3)
+				<< " + " << (location - start) << ", " << (end - location) << ") != 0) return executed;\n"
+				<< "\t\t\tgoto L_" << label << ";\n";
+		}
+	}
+
+	out << "\t\tdefault:\n"
+		<< "\t\t\treturn executed;\n"
+		<< "\t\t}\n\n";
+
+	for (const auto& block : blocks)
+	{
+		out << translate_block(block);
+	}
+
+	out << "\t}\n"
+		<< "}\n";
+
+	return out.str();
+}
+
+void Translator::trace()
+{
+	vector<double_byte> worklist{ PROGRAM_DATA_START_LOCATION };
+	leaders.set(PROGRAM_DATA_START_LOCATION);
+
+	const auto add_successor = [&](size_t location, bool is_leader)
+	{
+		if (location + 1 >= MEMORY_SIZE)
+		{
+			return;
+		}
+
+		if (is_leader)
+		{
+			leaders.set(location);
+		}
+		worklist.push_back(static_cast<double_byte>(location));
+	};
+
+	while (!worklist.empty())
+	{
+		const auto location = worklist.back();
+		worklist.pop_back();
+
+		if (reachable[location])
+		{
+			continue;
+		}
+		reachable.set(location);
+
+		const auto ins = decode(location);
+		const auto next = location + INSTRUCTION_SIZE;
+
+		if (ins.raw_instruction == 0)
+		{
+			continue;
+		}
+
+		if (Helper::needs_interpreter(ins))
+		{
+			add_successor(next, true);
+			continue;
+		}
+
+		switch (ins.category)
+		{
+		case 0x0:
+			// 00EE returns to call sites, which are traced from the 2NNN side.
+			if (ins.payload.NN == 0xE0)
+			{
+				add_successor(next, false);
+			}
+			break;
+		case 0x1:
+			add_successor(ins.payload.NNN, true);
+			break;
+		case 0x2:
+			add_successor(ins.payload.NNN, true);
+			add_successor(next, true);
+			break;
+		case 0x3: case 0x4: case 0x5: case 0x9: case 0xE:
+			add_successor(next, true);
+			add_successor(next + INSTRUCTION_SIZE, true);
+			break;
+		case 0xB:
+			// Jump tables almost always use even offsets. Odd targets are left to
+			// the interpreter.
+			for (size_t offset = 0; offset <= 0xFF; offset += INSTRUCTION_SIZE)
+			{
+				add_successor(ins.payload.NNN + offset, true);
+			}
+			break;
+		default:
+			add_successor(next, Helper::ends_block(ins));
+			break;
+		}
+	}
+}
+
+Instruction Translator::decode(double_byte location) const
+{
+	const auto raw = concatenate_bytes(machine.memory[location], machine.memory[location + 1]);
+	return CHIP_8::Helper::make_instruction_from_bytes(raw);
+}
+
+/**
+ * A block runs from a leader up to (and including) the first instruction which
+ * transfers control elsewhere, or up to the next leader.
+ */
+vector<double_byte> Translator::get_block(double_byte leader) const
+{
+	vector<double_byte> block{ leader };
+	for (auto location = leader; ; )
+	{
+		const auto ins = decode(location);
+		if (ins.raw_instruction == 0 || Helper::needs_interpreter(ins) || Helper::ends_block(ins))
+		{
+			break;
+		}
+
+		location += INSTRUCTION_SIZE;
+		if (location + 1 >= MEMORY_SIZE || !reachable[location] || leaders[location])
+		{
+			break;
+		}
+		block.push_back(location);
+	}
+
+	return block;
+}
+
+string Translator::translate_block(const vector<double_byte>& block) const
+{
+	string code;
+	for (const auto location : block)
+	{
+		code += translate_instruction(location);
+	}
+
+	const auto last = decode(block.back());
+	if (last.raw_instruction != 0 && !Helper::needs_interpreter(last) && !Helper::ends_block(last))
+	{
+		const auto next = block.back() + INSTRUCTION_SIZE;
+		code += "\t\tpc = 0x" + Helper::to_hex(next, 3) + ";\n"
+			"\t\tcontinue;\n";
+	}
+
+	return code + "\n";
+}
+
+string Translator::translate_instruction(double_byte location) const
+{
+	const auto ins = decode(location);
+	const auto& p = ins.payload;
+
+	const auto here = "0x" + Helper::to_hex(location, 3);
+	const auto next = "0x" + Helper::to_hex(location + INSTRUCTION_SIZE, 3);
+	const auto after_next = "0x" + Helper::to_hex(location + 2 * INSTRUCTION_SIZE, 3);
+	const auto X = "0x" + Helper::to_hex(p.X, 1);
+	const auto Y = "0x" + Helper::to_hex(p.Y, 1);
+	const auto NN = "0x" + Helper::to_hex(p.NN, 2);
+	const auto NNN = "0x" + Helper::to_hex(p.NNN, 3);
+
+	const auto exit_here = "{ pc = " + here + "; return executed; }";
+	const auto skip_if = [&](const string& condition)
+	{
+		return "\t\tpc = (" + condition + ") ? " + after_next + " : " + next + ";\n"
+			"\t\t++executed;\n"
+			"\t\tcontinue;\n";
+	};
+
+	string code = "\tL_" + Helper::to_hex(location, 3) + ": // " + Helper::to_hex(ins.raw_instruction, 4) + "\n";
+	if (ins.raw_instruction == 0 || Helper::needs_interpreter(ins))
+	{
+		return code + "\t\t" + exit_here + "\n";
+	}
+
+	code += "\t\tif (executed == budget) " + exit_here + "\n";
+
+	switch (ins.category)
+	{
+	case 0x0:
+		if (p.NN == 0xE0)
+		{
+			code += "\t\tctx.frame_buffer->clear();\n";
+			break;
+		}
+		return code +
+			"\t\tif (sp == 0) " + exit_here + "\n"
+			"\t\tpc = ctx.stack[--sp];\n"
+			"\t\t++executed;\n"
+			"\t\tcontinue;\n";
+	case 0x1:
+		return code +
+			"\t\tpc = " + NNN + ";\n"
+			"\t\t++executed;\n"
+			"\t\tcontinue;\n";
+	case 0x2:
+		return code +
+			"\t\tif (sp >= STACK_SIZE / STACK_ENTRY_SIZE) " + exit_here + "\n"
+			"\t\tctx.stack[sp++] = " + next + ";\n"
+			"\t\tpc = " + NNN + ";\n"
+			"\t\t++executed;\n"
+			"\t\tcontinue;\n";
+	case 0x3:
+		return code + skip_if("V[" + X + "] == " + NN);
+	case 0x4:
+		return code + skip_if("V[" + X + "] != " + NN);
+	case 0x5:
+		return code + skip_if("V[" + X + "] == V[" + Y + "]");
+	case 0x6:
+		code += "\t\tV[" + X + "] = " + NN + ";\n";
+		break;
+	case 0x7:
+		code += "\t\tV[" + X + "] += " + NN + ";\n";
+		break;
+	case 0x8:
+	{
+		const auto vx = "V[" + X + "]";
+		const auto vy = "V[" + Y + "]";
+		switch (p.N)
+		{
+		case 0x0:
+			code += "\t\t" + vx + " = " + vy + ";\n";
+			break;
+		case 0x1:
+			code += "\t\t" + vx + " |= " + vy + ";\n\t\tV[0xF] = 0;\n";
+			break;
+		case 0x2:
+			code += "\t\t" + vx + " &= " + vy + ";\n\t\tV[0xF] = 0;\n";
+			break;
+		case 0x3:
+			code += "\t\t" + vx + " ^= " + vy + ";\n\t\tV[0xF] = 0;\n";
+			break;
+		case 0x4:
+			code += "\t\t{ const int sum = " + vx + " + " + vy + "; " + vx + " = sum; V[0xF] = sum > 0xFF; }\n";
+			break;
+		case 0x5:
+			code += "\t\t{ const int diff = " + vx + " - " + vy + "; " + vx + " = diff; V[0xF] = diff >= 0; }\n";
+			break;
+		case 0x6:
+			code += "\t\t{ " + vx + " = " + vy + "; const byte lsb = " + vx + " & 1; " + vx + " >>= 1; V[0xF] = lsb; }\n";
+			break;
+		case 0x7:
+			code += "\t\t{ const int diff = " + vy + " - " + vx + "; " + vx + " = diff; V[0xF] = diff >= 0; }\n";
+			break;
+		case 0xE:
+			code += "\t\t{ " + vx + " = " + vy + "; const byte msb = (" + vx + " >> 7) & 1; " + vx + " <<= 1; V[0xF] = msb; }\n";
+			break;
+		}
+		break;
+	}
+	case 0x9:
+		return code + skip_if("V[" + X + "] != V[" + Y + "]");
+	case 0xA:
+		code += "\t\tI = " + NNN + ";\n";
+		break;
+	case 0xB:
+		return code +
+			"\t\tpc = V[0x0] + " + NNN + ";\n"
+			"\t\t++executed;\n"
+			"\t\tcontinue;\n";
+	case 0xC:
+		code += "\t\tV[" + X + "] = ctx.random_byte(ctx.machine) & " + NN + ";\n";
+		break;
+	case 0xD:
+		code += "\t\tdraw(ctx, " + X + ", " + Y + ", " + to_string(p.N) + ");\n";
+		break;
+	case 0xE:
+	{
+		// Keys past KF are rejected by Keyboard; let the interpreter report it.
+		code += "\t\tif (V[" + X + "] > 0xF) " + exit_here + "\n";
+		const auto pressed = "ctx.is_key_pressed(ctx.machine, V[" + X + "])";
+		return code + skip_if(p.NN == 0x9E ? pressed : "!" + pressed);
+	}
+	case 0xF:
+		switch (p.NN)
+		{
+		case 0x07:
+			code += "\t\tV[" + X + "] = ctx.delay_timer->value_at(ctx.cycles + executed);\n";
+			break;
+		case 0x15:
+			code += "\t\tctx.delay_timer->set(ctx.cycles + executed, V[" + X + "]);\n";
+			break;
+		case 0x18:
+			code += "\t\tctx.sound_timer->set(ctx.cycles + executed, V[" + X + "]);\n";
+			break;
+		case 0x1E:
+			code += "\t\tI += V[" + X + "];\n";
+			break;
+		case 0x29:
+			code += "\t\tI = FONT_DATA_START_LOCATION + FONT_CHAR_SIZE * V[" + X + "];\n";
+			break;
+		case 0x55:
+			// Memory writes may modify translated code, so re-enter through the
+			// dispatcher which checks the block bytes again.
+			return code +
+				"\t\tfor (int i = 0; i <= " + X + "; ++i) { const auto a = wrap_address(I++); *ctx.dirty_pages |= std::uint64_t{ 1 } << (a / PAGE_SIZE); memory[a] = V[i]; }\n"
+				"\t\tpc = " + next + ";\n"
+				"\t\t++executed;\n"
+				"\t\tcontinue;\n";
+		case 0x65:
+			code += "\t\tfor (int i = 0; i <= " + X + "; ++i) V[i] = memory[wrap_address(I++)];\n";
+			break;
+		}
+		break;
+	}
+
+	return code + "\t\t++executed;\n";
+}
+
+/**
+ * Instructions which block, fault, or are rarely worth translating are left to
+ * the interpreter.
+ */
+bool Translator::Helper::needs_interpreter(const Instruction& ins)
+{
+	const auto& p = ins.payload;
+	switch (ins.category)
+	{
+	case 0x0:
+		return !(p.X == 0x0 && p.Y == 0xE && (p.N == 0x0 || p.N == 0xE));
+	case 0x5: case 0x9:
+		return p.N != 0;
+	case 0x8:
+		return p.N > 0x7 && p.N != 0xE;
+	case 0xE:
+		return p.NN != 0x9E && p.NN != 0xA1;
+	case 0xF:
+		switch (p.NN)
+		{
+		case 0x07: case 0x15: case 0x18: case 0x1E: case 0x29: case 0x55: case 0x65:
+			return false;
+		default:
+			// Includes Fx0A, which blocks, and Fx33.
+			return true;
+		}
+	default:
+		return false;
+	}
+}
+
+bool Translator::Helper::ends_block(const Instruction& ins)
+{
+	switch (ins.category)
+	{
+	case 0x0:
+		return ins.payload.NN == 0xEE;
+	case 0x1: case 0x2: case 0x3: case 0x4: case 0x5: case 0x9: case 0xB: case 0xE:
+		return true;
+	case 0xF:
+		return ins.payload.NN == 0x55;
+	default:
+		return false;
+	}
+}
+
+string Translator::Helper::to_hex(unsigned value, int width)
+{
+	ostringstream out;
+	out << hex << uppercase << setw(width) << setfill('0') << value;
+	return out.str();
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <bitset>
+#include <string>
+#include <vector>
+
+#include "CHIP-8.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+
+/**
+ * Ahead-of-time translator from a loaded CHIP-8 program to C++.
+ *
+ * The translator traces the code reachable from PROGRAM_DATA_START_LOCATION,
+ * splits it into basic blocks and emits straight-line C++ for every block.
+ * The result is meant to be compiled into a shared library and loaded with
+ * Compiled_program.
+ *
+ * Blocks check at runtime that the bytes they were translated from are still
+ * in memory, so self-modifying code falls back to the interpreter. Instructions
+ * which can't be translated faithfully (e.g., Fx0A, invalid opcodes) also hand
+ * control back to the interpreter.
+ */
+class Translator
+{
+public:
+	explicit Translator(const CHIP_8& machine);
+
+	std::string translate() const;
+private:
+	const CHIP_8& machine;
+
+	std::bitset<MEMORY_SIZE> reachable;
+	std::bitset<MEMORY_SIZE> leaders;
+
+	void trace();
+	Instruction decode(double_byte location) const;
+	std::vector<double_byte> get_block(double_byte leader) const;
+
+	std::string translate_block(const std::vector<double_byte>& block) const;
+	std::string translate_instruction(double_byte location) const;
+
+	class Helper
+	{
+	public:
+		static bool needs_interpreter(const Instruction& ins);
+		static bool ends_block(const Instruction& ins);
+		static std::string to_hex(unsigned value, int width);
+	};
+};
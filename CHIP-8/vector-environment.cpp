@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "vector-environment.hpp"
+#include "CHIP-8.hpp"
+#include "keyboard.hpp"
+#include "render.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+
+using std::lock_guard;
+using std::unique_lock;
+using std::make_unique;
+
+Vector_environment::Vector_environment(const std::array<byte, MAX_NUM_INSTRUCTIONS * INSTRUCTION_SIZE>& program,
+	size_t num_machines, size_t num_threads, size_t frames_per_step, std::uint32_t seed)
+	: num_machines{ num_machines }, num_chunks{ std::max<size_t>(std::min(num_threads, num_machines), 1) },
+	frames_per_step{ frames_per_step }, machines{ make_unique<CHIP_8[]>(num_machines) },
+	seeds{ make_unique<std::uint32_t[]>(num_machines) }, observations{ make_unique<byte[]>(num_machines * BYTE_IMAGE_SIZE) },
+	done{ make_unique<bool[]>(num_machines) }, faults{ make_unique<Fault_code[]>(num_machines) },
+	job{ Job::RESET }, keys{ nullptr }, which{ nullptr }, generation{ 0 }, num_busy_workers{ 0 }, stopping{ false }
+{
+	// Every machine starts off the same snapshot, which shares its memory.
+	CHIP_8 loader;
+	loader.load_program_from_bytes(program);
+	initial_state = loader.take_snapshot();
+
+	for (size_t i = 0; i < num_machines; ++i)
+	{
+		seeds[i] = static_cast<std::uint32_t>(seed + i);
+	}
+
+	for (size_t chunk = 1; chunk < num_chunks; ++chunk)
+	{
+		workers.emplace_back(&Vector_environment::work, this, chunk);
+	}
+
+	reset();
+}
+
+Vector_environment::~Vector_environment()
+{
+	{
+		lock_guard<std::mutex> lock{ mutex };
+		stopping = true;
+	}
+	wake_up.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+/**
+ * Runs a frame (or frames_per_step) of every machine which isn't done, with
+ * `keys[i]` pressed on machine i and every other key released.
+ */
+void Vector_environment::step(const Key_mask* keys)
+{
+	this->keys = keys;
+	run_job(Job::STEP);
+}
+
+/**
+ * Puts the machines for which `which[i]` is set, or all of them, back at the
+ * start of the program with a new seed and no keys pressed.
+ */
+void Vector_environment::reset(const bool* which)
+{
+	this->which = which;
+	run_job(Job::RESET);
+}
+
+size_t Vector_environment::size() const
+{
+	return num_machines;
+}
+
+size_t Vector_environment::get_frames_per_step() const
+{
+	return frames_per_step;
+}
+
+/**
+ * The screens of all machines, BYTE_IMAGE_SIZE bytes each, as of the last step
+ * or reset.
+ */
+const byte* Vector_environment::get_observations() const
+{
+	return observations.get();
+}
+
+const bool* Vector_environment::get_done() const
+{
+	return done.get();
+}
+
+const Fault_code* Vector_environment::get_faults() const
+{
+	return faults.get();
+}
+
+CHIP_8& Vector_environment::get_machine(size_t i)
+{
+	return machines[i];
+}
+
+/**
+ * Runs the job on all chunks, one of them on the calling thread, and returns
+ * once they are all done.
+ */
+void Vector_environment::run_job(Job job)
+{
+	{
+		lock_guard<std::mutex> lock{ mutex };
+		this->job = job;
+		++generation;
+		num_busy_workers = workers.size();
+	}
+	wake_up.notify_all();
+
+	run_chunk(0);
+
+	unique_lock<std::mutex> lock{ mutex };
+	finished.wait(lock, [this] { return num_busy_workers == 0; });
+}
+
+void Vector_environment::run_chunk(size_t chunk)
+{
+	const auto begin = num_machines * chunk / num_chunks;
+	const auto end = num_machines * (chunk + 1) / num_chunks;
+	for (auto i = begin; i < end; ++i)
+	{
+		if (job == Job::STEP)
+		{
+			step_machine(i);
+		}
+		else if (which == nullptr || which[i])
+		{
+			reset_machine(i);
+		}
+	}
+}
+
+void Vector_environment::work(size_t chunk)
+{
+	std::uint64_t last_generation = 0;
+
+	unique_lock<std::mutex> lock{ mutex };
+	for (;;)
+	{
+		wake_up.wait(lock, [&] { return stopping || generation != last_generation; });
+		if (stopping)
+		{
+			return;
+		}
+		last_generation = generation;
+
+		lock.unlock();
+		run_chunk(chunk);
+		lock.lock();
+
+		if (--num_busy_workers == 0)
+		{
+			finished.notify_one();
+		}
+	}
+}
+
+void Vector_environment::step_machine(size_t i)
+{
+	if (done[i])
+	{
+		return;
+	}
+
+	auto& machine = machines[i];
+	machine.keyboard.set_pressed_keys(keys[i]);
+	const auto status = machine.run_frames(frames_per_step).status;
+
+	done[i] = status == Run_status::FINISHED || status == Run_status::FAULTED;
+	faults[i] = machine.get_fault().code;
+	render_bytes(machine.get_frame_buffer(), observations.get() + i * BYTE_IMAGE_SIZE);
+}
+
+void Vector_environment::reset_machine(size_t i)
+{
+	auto& machine = machines[i];
+	machine.restore_snapshot(initial_state);
+	machine.keyboard.set_pressed_keys(0);
+	machine.seed_random(seeds[i]);
+	seeds[i] += static_cast<std::uint32_t>(num_machines);
+
+	done[i] = false;
+	faults[i] = Fault_code::NONE;
+	render_bytes(machine.get_frame_buffer(), observations.get() + i * BYTE_IMAGE_SIZE);
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "CHIP-8.hpp"
+#include "keyboard.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+
+/**
+ * Many machines running the same program, stepped together a frame at a time
+ * with a set of keys each, as reinforcement learning environments are.
+ *
+ * Steps are split between a fixed set of threads, the calling one included,
+ * and write into buffers which are allocated once: an image of every screen
+ * (see render_bytes), and whether every machine is done and why. A machine is
+ * done once its program has finished or faulted, and isn't run again until it
+ * is reset.
+ *
+ * Only one thread may call step or reset at a time.
+ */
+class Vector_environment
+{
+public:
+	Vector_environment(const std::array<byte, MAX_NUM_INSTRUCTIONS * INSTRUCTION_SIZE>& program, size_t num_machines,
+		size_t num_threads = std::thread::hardware_concurrency(), size_t frames_per_step = 1,
+		std::uint32_t seed = DEFAULT_RANDOM_SEED);
+	~Vector_environment();
+
+	Vector_environment(const Vector_environment&) = delete;
+	Vector_environment& operator=(const Vector_environment&) = delete;
+
+	void step(const Key_mask* keys);
+	void reset(const bool* which = nullptr);
+
+	size_t size() const;
+	size_t get_frames_per_step() const;
+
+	const byte* get_observations() const;
+	const bool* get_done() const;
+	const Fault_code* get_faults() const;
+
+	CHIP_8& get_machine(size_t i);
+private:
+	enum class Job
+	{
+		STEP, RESET
+	};
+
+	void run_job(Job job);
+	void run_chunk(size_t chunk);
+	void work(size_t chunk);
+	void step_machine(size_t i);
+	void reset_machine(size_t i);
+
+	size_t num_machines;
+	size_t num_chunks;
+	size_t frames_per_step;
+
+	std::unique_ptr<CHIP_8[]> machines;
+	CHIP_8::Snapshot initial_state;
+
+	// Every machine's next seed, which moves on by num_machines on each reset
+	// so that no two episodes share one.
+	std::unique_ptr<std::uint32_t[]> seeds;
+
+	std::unique_ptr<byte[]> observations;
+	std::unique_ptr<bool[]> done;
+	std::unique_ptr<Fault_code[]> faults;
+
+	// The arguments of the job being run.
+	Job job;
+	const Key_mask* keys;
+	const bool* which;
+
+	// Guards everything below and wakes up the workers for every new job,
+	// and the caller once they have all finished it.
+	std::mutex mutex;
+	std::condition_variable wake_up;
+	std::condition_variable finished;
+	std::uint64_t generation;
+	size_t num_busy_workers;
+	bool stopping;
+
+	// Worker i runs chunk i + 1 of every job.
+	std::vector<std::thread> workers;
+};
\ No newline at end of file
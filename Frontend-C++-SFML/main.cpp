@@ -4,6 +4,12 @@
 #include <vector>
 #include <chrono>
 #include <unordered_map>
+#include <memory>
+#include <random>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <exception>
 
 #include <SFML/Graphics.hpp>
 #include <SFML/Window/Keyboard.hpp>
@@ -13,18 +19,31 @@
 #include "data-types.hpp"
 #include "machine-specs.hpp"
 #include "keyboard.hpp"
-
-using std::chrono::system_clock;
-using std::chrono::duration_cast;
-using std::chrono::milliseconds;
-using std::chrono::seconds;
+#include "movie.hpp"
+#include "telemetry.hpp"
+#include "frame-publisher.hpp"
+#include "run-ahead.hpp"
+#include "render.hpp"
+
+using std::chrono::steady_clock;
+using std::chrono::nanoseconds;
+using std::chrono::duration;
 using std::cerr;
 using std::ifstream;
+using std::ofstream;
 using std::array;
 using std::ios;
 using std::vector;
-using std::istream;
 using std::unordered_map;
+using std::unique_ptr;
+using std::make_unique;
+using std::string;
+using std::stoul;
+using std::ostringstream;
+using std::fixed;
+using std::setprecision;
+using std::random_device;
+using std::exception;
 
 using sf::RenderWindow;
 using sf::VideoMode;
@@ -38,6 +57,8 @@ using sf::Color;
 using sf::Texture;
 using sf::Uint8;
 using sf::Sprite;
+using sf::Font;
+using sf::Text;
 
 const unordered_map<sf::Keyboard::Scancode, Key> KBD_TO_CHIP_8 = {
 	{ sf::Keyboard::Scan::X, Key::K0 },
@@ -64,21 +85,99 @@ static Texture load_texture_from_frame_buffer(const Frame_buffer& fb);
 bool redraw_necessary(const Frame_buffer& fb);
 
 template <size_t SCALING_FACTOR>
-void redraw_if_necessary(RenderWindow& window, const Frame_buffer& fb);
+bool redraw_if_necessary(RenderWindow& window, const Frame_buffer& fb, const Text* overlay);
+
+string describe_telemetry(const Telemetry_counters& counters);
 
-void load_program_from_stream(istream& stream, CHIP_8& machine);
 
 int main(int argc, char* argv[])
 {
-	if (argc != 2)
+	if (argc < 2 || argc % 2 != 0)
 	{
-		cerr << "Usage: " << argv[0] << " file\n";
+		cerr << "Usage: " << argv[0] << " file [--record movie | --play movie] [--overlay font] [--publish name] [--run-ahead frames]\n";
 		return 1;
 	}
 
 	ifstream rom{ argv[1], ios::binary };
 	CHIP_8 machine;
-	load_program_from_stream(rom, machine);
+	machine.load_program_from_bytes(read_program(rom));
+
+	// While playing a movie, the movie provides all input and timing.
+	unique_ptr<Movie_recorder> recorder;
+	unique_ptr<Movie_player> player;
+	string recording_path;
+
+	// The overlay shows the telemetry on top of the screen.
+	Font overlay_font;
+	unique_ptr<Text> overlay;
+
+	// Lets other processes watch the machine, see Tools/frame-viewer.
+	unique_ptr<Frame_publisher> publisher;
+
+	// Shows the screen a few frames early, see Run_ahead.
+	Run_ahead run_ahead{ machine, 0 };
+
+	for (int i = 2; i + 1 < argc; i += 2)
+	{
+		const string option = argv[i];
+		if (option == "--record")
+		{
+			recorder = make_unique<Movie_recorder>(machine, random_device{}());
+			recording_path = argv[i + 1];
+		}
+		else if (option == "--play")
+		{
+			ifstream movie_file{ argv[i + 1], ios::binary };
+			try
+			{
+				player = make_unique<Movie_player>(machine, load_movie(movie_file));
+			}
+			catch (const exception& e)
+			{
+				cerr << argv[i + 1] << ": " << e.what() << '\n';
+				return 1;
+			}
+		}
+		else if (option == "--overlay")
+		{
+			if (!overlay_font.loadFromFile(argv[i + 1]))
+			{
+				cerr << "Cannot load font " << argv[i + 1] << '\n';
+				return 1;
+			}
+
+			overlay = make_unique<Text>("", overlay_font, 12);
+			overlay->setFillColor(Color::Red);
+			overlay->setPosition(4, 4);
+		}
+		else if (option == "--publish")
+		{
+			try
+			{
+				publisher = make_unique<Frame_publisher>(argv[i + 1]);
+			}
+			catch (const exception& e)
+			{
+				cerr << e.what() << '\n';
+				return 1;
+			}
+		}
+		else if (option == "--run-ahead")
+		{
+			run_ahead.set_frames(stoul(argv[i + 1]));
+		}
+		else
+		{
+			cerr << "Unknown option: " << option << '\n';
+			return 1;
+		}
+	}
+
+	if (recorder && player)
+	{
+		cerr << "Cannot record and play a movie at the same time\n";
+		return 1;
+	}
 
 	constexpr auto SCALING_FACTOR = 10;
 	auto window = RenderWindow{
@@ -87,55 +186,125 @@ int main(int argc, char* argv[])
 		Titlebar | Close
 	};
 
-	auto last_limiter_check_time = system_clock::now();
+	// Falling further behind than this, e.g. while the window is dragged,
+	// skips the refreshes instead of running all of them at once.
+	constexpr auto MAX_REFRESHES_BEHIND = 4;
+	constexpr nanoseconds refresh_period{ NANOSECONDS_PER_REFRESH };
+
+	Telemetry telemetry;
+	auto last_limiter_check_time = steady_clock::now();
+	bool fault_reported = false;
+	const auto handle_event = [&](const Event& e)
+	{
+		switch (e.type)
+		{
+		case Closed:
+			window.close();
+			break;
+		case KeyPressed:
+			if (!player && KBD_TO_CHIP_8.find(e.key.scancode) != KBD_TO_CHIP_8.end())
+			{
+				machine.keyboard.set_key_pressed(KBD_TO_CHIP_8.at(e.key.scancode));
+			}
+			break;
+		case KeyReleased:
+			if (!player && KBD_TO_CHIP_8.find(e.key.scancode) != KBD_TO_CHIP_8.end())
+			{
+				machine.keyboard.set_key_released(KBD_TO_CHIP_8.at(e.key.scancode));
+			}
+			break;
+		}
+	};
+
 	for (bool rom_running = true; window.isOpen(); )
 	{
-		for (Event e; window.pollEvent(e); )
+		// A machine waiting for a key can't do anything until the next event, so
+		// sleep until it arrives. The time slept still passes for the machine,
+		// before the event which woke us up.
+		if (!player && machine.is_waiting_for_key())
 		{
-			switch (e.type)
+			Event e;
+			const auto has_event = window.waitEvent(e);
+
+			const auto refreshes_slept = (steady_clock::now() - last_limiter_check_time) / refresh_period;
+			machine.run(static_cast<size_t>(refreshes_slept * INSTRUCTIONS_PER_REFRESH));
+			last_limiter_check_time += refreshes_slept * refresh_period;
+
+			if (has_event)
 			{
-			case Closed:
-				window.close();
-				break;
-			case KeyPressed:
-				if (KBD_TO_CHIP_8.find(e.key.scancode) != KBD_TO_CHIP_8.end())
-				{
-					machine.keyboard.set_key_pressed(KBD_TO_CHIP_8.at(e.key.scancode));
-				}
-				break;
-			case KeyReleased:
-				if (KBD_TO_CHIP_8.find(e.key.scancode) != KBD_TO_CHIP_8.end())
-				{
-					machine.keyboard.set_key_released(KBD_TO_CHIP_8.at(e.key.scancode));
-				}
-				break;
+				handle_event(e);
 			}
 		}
 
-		const auto curr_time = system_clock::now();
+		for (Event e; window.pollEvent(e); )
+		{
+			handle_event(e);
+		}
 
-		const auto time_elapsed = curr_time - last_limiter_check_time;
-		const auto milliseconds_elapsed = duration_cast<milliseconds>(time_elapsed).count();
+		const auto curr_time = steady_clock::now();
 
-		if (milliseconds_elapsed < MILLISECONDS_PER_REFRESH)
+		// Only whole refreshes are consumed, the remainder carries over to the
+		// next check.
+		const auto refreshes_due = (curr_time - last_limiter_check_time) / refresh_period;
+		if (refreshes_due == 0)
 		{
 			continue;
 		}
-		last_limiter_check_time = curr_time;
+		last_limiter_check_time += refreshes_due * refresh_period;
+
+		const auto refreshes_skipped = refreshes_due > MAX_REFRESHES_BEHIND ? refreshes_due - MAX_REFRESHES_BEHIND : 0;
+		const auto refreshes_elapsed = refreshes_due - refreshes_skipped;
+
+		const auto execute_start = steady_clock::now();
+		size_t instructions_executed = 0;
+
+		if (rom_running)
+		{
+			const auto result = player
+				? player->run_frames(refreshes_elapsed)
+				: machine.run_frames(refreshes_elapsed);
+			instructions_executed = result.instructions_executed;
+			rom_running = result.status == Run_status::RUNNING || result.status == Run_status::WAITING_FOR_KEY;
+
+			// A movie's input is known in advance, so there's no lag to hide.
+			if (!player)
+			{
+				run_ahead.update();
+			}
+		}
 
-		const auto refreshes_elapsed = milliseconds_elapsed / MILLISECONDS_PER_REFRESH;
+		if (!rom_running && machine.get_fault().code != Fault_code::NONE && !fault_reported)
+		{
+			const auto& fault = machine.get_fault();
+			cerr << "Machine faulted at " << std::hex << fault.pc << " on instruction " << fault.instruction << '\n';
+			fault_reported = true;
+		}
 
-		const size_t nins = refreshes_elapsed * INSTRUCTIONS_PER_REFRESH;
-		for (size_t i = 0; rom_running && i < nins; ++i)
+		if (publisher)
 		{
-			rom_running = machine.run_one();
+			publisher->publish(machine);
 		}
 
-		const size_t timer_decrements_elapsed = refreshes_elapsed * TIMER_DECREMENTS_PER_REFRESH;
-		machine.decrement_timers(timer_decrements_elapsed);
+		telemetry.add_execution(instructions_executed, steady_clock::now() - execute_start);
+		telemetry.add_frames(refreshes_elapsed, refreshes_skipped);
+		telemetry.add_missed_timer_ticks(refreshes_skipped * TIMER_DECREMENTS_PER_REFRESH);
 
-		const auto& frame_buffer = machine.get_frame_buffer();
-		redraw_if_necessary<SCALING_FACTOR>(window, frame_buffer);
+		if (overlay)
+		{
+			overlay->setString(describe_telemetry(telemetry.read()));
+		}
+
+		const auto render_start = steady_clock::now();
+		if (redraw_if_necessary<SCALING_FACTOR>(window, run_ahead.get_frame_buffer(), overlay.get()))
+		{
+			telemetry.add_render(steady_clock::now() - render_start);
+		}
+	}
+
+	if (recorder)
+	{
+		ofstream movie_file{ recording_path, ios::binary };
+		save_movie(recorder->get_movie(), movie_file);
 	}
 }
 
@@ -143,29 +312,22 @@ bool redraw_necessary(const Frame_buffer& fb)
 {
 	static Frame_buffer previous_fb{};
 
-	bool necessary = false;
-	for (size_t x = 0; x < fb.size(); ++x)
-	{
-		for (size_t y = 0; y < fb[0].size(); ++y)
-		{
-			if (previous_fb[x][y] != fb[x][y])
-			{
-				necessary = true;
-			}
-
-			previous_fb[x][y] = fb[x][y];
-		}
-	}
+	const bool necessary = previous_fb != fb;
+	previous_fb = fb;
 
 	return necessary;
 }
 
+/**
+ * Returns whether the window was redrawn. With an overlay, whose text changes
+ * all the time, that is always the case.
+ */
 template <size_t SCALING_FACTOR>
-void redraw_if_necessary(RenderWindow& window, const Frame_buffer& fb)
+bool redraw_if_necessary(RenderWindow& window, const Frame_buffer& fb, const Text* overlay)
 {
-	if (!redraw_necessary(fb))
+	if (!redraw_necessary(fb) && !overlay)
 	{
-		return;
+		return false;
 	}
 
 	const auto screen_texture = load_texture_from_frame_buffer<SCALING_FACTOR>(fb);
@@ -173,61 +335,42 @@ void redraw_if_necessary(RenderWindow& window, const Frame_buffer& fb)
 
 	window.clear();
 	window.draw(screen_sprite);
+	if (overlay)
+	{
+		window.draw(*overlay);
+	}
 	window.display();
+
+	return true;
 }
 
-template <size_t SCALING_FACTOR>
-static Texture load_texture_from_frame_buffer(const Frame_buffer& fb)
+string describe_telemetry(const Telemetry_counters& counters)
 {
-	constexpr auto NUM_CHANNELS = 4;
-	constexpr auto OPAQUE = 255;
-	constexpr auto BLACK = 0;
-	constexpr auto WHITE = 255;
-
-	static auto pixels = new Uint8[FRAME_BUFFER_WIDTH * SCALING_FACTOR * FRAME_BUFFER_HEIGHT * SCALING_FACTOR * NUM_CHANNELS];
-
-	for (size_t x = 0; x < FRAME_BUFFER_WIDTH; ++x)
+	const auto per_frame = [&counters](nanoseconds time)
 	{
-		for (size_t y = 0; y < FRAME_BUFFER_HEIGHT; ++y)
-		{
-			const bool is_black = fb[x][y];
-
-			const auto startx = x * SCALING_FACTOR;
-			const auto starty = y * SCALING_FACTOR;
-
-			for (size_t i = 0; i < SCALING_FACTOR; ++i)
-			{
-				for (size_t j = 0; j < SCALING_FACTOR; ++j)
-				{
-					const auto pixel_offset = ((starty + i) * FRAME_BUFFER_WIDTH * SCALING_FACTOR + (startx + j)) * NUM_CHANNELS;
-					pixels[pixel_offset + 3] = OPAQUE;
-					pixels[pixel_offset + 0] = pixels[pixel_offset + 1] = pixels[pixel_offset + 2] = is_black ? BLACK : WHITE;
-				}
-			}
-		}
-	}
+		const duration<double, std::milli> total = time;
+		return counters.frames_produced ? total.count() / counters.frames_produced : 0.0;
+	};
 
-	auto texture = Texture{};
-	texture.create(FRAME_BUFFER_WIDTH * SCALING_FACTOR, FRAME_BUFFER_HEIGHT * SCALING_FACTOR);
-	texture.update(pixels);
+	ostringstream description;
+	description << fixed << setprecision(0) << counters.instructions_per_second << " IPS, "
+		<< counters.frames_produced << " frames, " << counters.frames_skipped << " skipped, "
+		<< counters.timer_ticks_missed << " timer ticks missed\n"
+		<< setprecision(3) << "execute " << per_frame(counters.execute_time) << " ms, render "
+		<< per_frame(counters.render_time) << " ms per frame";
 
-	return texture;
+	return description.str();
 }
 
-void load_program_from_stream(istream& stream, CHIP_8& machine)
+template <size_t SCALING_FACTOR>
+static Texture load_texture_from_frame_buffer(const Frame_buffer& fb)
 {
-	constexpr auto max_num_bytes = MAX_NUM_INSTRUCTIONS * INSTRUCTION_SIZE;
-	array<byte, max_num_bytes> bytes{};
-	bytes.fill(0);
-	for (auto& b : bytes)
-	{
-		if (!stream)
-		{
-			break;
-		}
+	static array<Uint8, get_rgba_image_size(SCALING_FACTOR)> pixels;
+	render_rgba(fb, DEFAULT_PALETTE, SCALING_FACTOR, pixels.data());
 
-		b = stream.get();
-	}
+	auto texture = Texture{};
+	texture.create(FRAME_BUFFER_WIDTH * SCALING_FACTOR, FRAME_BUFFER_HEIGHT * SCALING_FACTOR);
+	texture.update(pixels.data());
 
-	machine.load_program_from_bytes(bytes);
+	return texture;
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
-from PyCHIP8.PyCHIP8 import CHIP_8, Debugger
+from PyCHIP8.PyCHIP8 import CHIP_8, Debugger, Telemetry, RunAhead
 
 
 machine = CHIP_8()
 debugger = Debugger(machine)
+telemetry = Telemetry()
+run_ahead = RunAhead(machine)
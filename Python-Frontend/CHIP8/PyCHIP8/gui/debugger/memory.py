@@ -1,21 +1,30 @@
 from PySide6.QtCore import QStringListModel
 from PySide6.QtWidgets import QListView
 
+from PyCHIP8.PyCHIP8 import DebugEventKind, ExecutionEvent
 from PyCHIP8.emulator import debugger
-from PyCHIP8.host.helpers import affects_memory
 
 
 class MemoryModel(QStringListModel):
     def __init__(self):
         super().__init__()
 
-        debugger.on_exec(self.refresh_if_needed)
+        self.setStringList([hex(item) for item in debugger.memory])
+        debugger.take_memory_changes()
 
-    def refresh_if_needed(self, _, instruction):
-        if not affects_memory(instruction):
-            return
-        items = [hex(item) for item in debugger.memory]
-        self.setStringList(items)
+        # refreshed once per frame in which something was written
+        debugger.subscribe([DebugEventKind.MEMORY_WRITE], lambda _: self.refresh())
+        debugger.on_exec(self.refresh_after_going_back)
+
+    def refresh_after_going_back(self, event, _):
+        # no event reports the writes going back undoes
+        if event == ExecutionEvent.GO_BACK_ONE:
+            self.refresh()
+
+    def refresh(self):
+        # only the locations written since the last refresh are updated
+        for change in debugger.take_memory_changes():
+            self.setData(self.index(change.address), hex(change.new_value))
 
 
 class MemoryView(QListView):
@@ -26,3 +35,6 @@ class MemoryView(QListView):
 
         self.setWindowTitle("Memory")
         self.setModel(MemoryModel())
+
+    def refresh(self):
+        self.model().refresh()
@@ -1,21 +1,30 @@
 from PySide6.QtCore import QStringListModel
 from PySide6.QtWidgets import QListView
 
+from PyCHIP8.PyCHIP8 import DebugEventKind, ExecutionEvent
 from PyCHIP8.emulator import debugger
-from PyCHIP8.host.helpers import affects_registers
 
 
 class RegistersModel(QStringListModel):
     def __init__(self):
         super().__init__()
 
-        debugger.on_exec(self.refresh_if_needed)
+        self.setStringList([hex(item) for item in debugger.registers + [debugger.index_register]])
+        debugger.take_register_changes()
 
-    def refresh_if_needed(self, _, ins):
-        if not affects_registers(ins):
-            return
-        items = [hex(item) for item in debugger.registers + [debugger.index_register]]
-        self.setStringList(items)
+        # refreshed once per frame in which something was written
+        debugger.subscribe([DebugEventKind.REGISTER_WRITE], lambda _: self.refresh())
+        debugger.on_exec(self.refresh_after_going_back)
+
+    def refresh_after_going_back(self, event, _):
+        # no event reports the writes going back undoes
+        if event == ExecutionEvent.GO_BACK_ONE:
+            self.refresh()
+
+    def refresh(self):
+        # the index register comes last, which is also where its change id points
+        for change in debugger.take_register_changes():
+            self.setData(self.index(change.id), hex(change.new_value))
 
 
 class RegistersView(QListView):
@@ -26,3 +35,6 @@ class RegistersView(QListView):
 
         self.setWindowTitle("Registers")
         self.setModel(RegistersModel())
+
+    def refresh(self):
+        self.model().refresh()
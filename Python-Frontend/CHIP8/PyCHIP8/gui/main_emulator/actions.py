@@ -1,5 +1,6 @@
 from PySide6.QtGui import QAction
 
+from PyCHIP8.emulator import run_ahead
 from PyCHIP8.host.consts import ExecutionMode
 
 
@@ -10,6 +11,45 @@ class LoadROMAction(QAction):
         self.triggered.connect(self.parent().load_rom)
 
 
+class RecordMovieAction(QAction):
+    def __init__(self, parent):
+        super().__init__("", parent)
+
+        self.refresh_name()
+        self.setStatusTip("Restart the ROM and record all input into a movie, or stop recording and save the movie.")
+        self.triggered.connect(self.trigger_action)
+
+    def trigger_action(self):
+        self.parent().toggle_recording()
+        self.refresh_name()
+
+    def refresh_name(self):
+        self.setText("Record Movie" if self.parent().recorder is None else "Stop Recording")
+
+
+class PlayMovieAction(QAction):
+    def __init__(self, parent):
+        super().__init__("Play Movie", parent)
+        self.setStatusTip("Restart the ROM and replay a recorded movie.")
+        self.triggered.connect(self.parent().play_movie)
+
+
+class ToggleRunAheadAction(QAction):
+    def __init__(self, parent):
+        super().__init__("", parent)
+
+        self.refresh_name()
+        self.setStatusTip("Show the screen a frame ahead of the machine, which hides the lag of most ROMs.")
+        self.triggered.connect(self.trigger_action)
+
+    def trigger_action(self):
+        self.parent().toggle_run_ahead()
+        self.refresh_name()
+
+    def refresh_name(self):
+        self.setText("Run Ahead" if run_ahead.frames == 0 else "Stop Running Ahead")
+
+
 class ToggleBreakModeAction(QAction):
     def __init__(self, parent):
         super().__init__("", parent)
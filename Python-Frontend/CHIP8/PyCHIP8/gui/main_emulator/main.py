@@ -1,15 +1,23 @@
+import random
+import time
+from datetime import timedelta
+
 from PySide6.QtCore import QTimer
 from PySide6.QtWidgets import QApplication, QGraphicsView, QGraphicsScene, QMainWindow, QToolBar, QFileDialog
 
-from PyCHIP8.PyCHIP8 import MILLISECONDS_PER_REFRESH, INSTRUCTIONS_PER_REFRESH, TIMER_DECREMENTS_PER_REFRESH
-from PyCHIP8.emulator import machine, debugger
+from PyCHIP8.PyCHIP8 import MILLISECONDS_PER_REFRESH, TIMER_DECREMENTS_PER_REFRESH, \
+    SCREEN_REFRESHES_PER_SECOND, FRAME_BUFFER_WIDTH, FRAME_BUFFER_HEIGHT, MovieRecorder, MoviePlayer, load_movie, save_movie, \
+    DebugEventKind, ExecutionEvent
+from PyCHIP8.emulator import machine, debugger, telemetry, run_ahead
 
-from PyCHIP8.host.consts import KBD_TO_CHIP_8, SCALING_FACTOR, DEBUG_GO_FORWARD_KEY, DEBUG_GO_BACK_KEY, ExecutionMode
-from PyCHIP8.host.helpers import get_bytes, get_graphics_from_frame_buffer, affects_screen
+from PyCHIP8.host.consts import KBD_TO_CHIP_8, SCALING_FACTOR, RUN_AHEAD_FRAMES, DEBUG_GO_FORWARD_KEY, DEBUG_GO_BACK_KEY, \
+    ExecutionMode
+from PyCHIP8.host.helpers import get_bytes, get_graphics_from_frame_buffer
 
 from PyCHIP8.gui.debugger.registers import RegistersView
 from PyCHIP8.gui.debugger.memory import MemoryView
-from PyCHIP8.gui.main_emulator.actions import LoadROMAction, ToggleBreakModeAction, ToggleDebugMode
+from PyCHIP8.gui.main_emulator.actions import LoadROMAction, ToggleBreakModeAction, ToggleDebugMode, \
+    RecordMovieAction, PlayMovieAction, ToggleRunAheadAction
 
 
 class CHIP8App(QApplication):
@@ -19,15 +27,27 @@ class CHIP8App(QApplication):
         self.previous_execution_mode = None
         self.execution_mode = ExecutionMode.NORMAL
 
+        self.rom_name = None
+        # at most one of these is set; while a movie plays, it provides all input
+        self.recorder = None
+        self.player = None
+
+        # the timer can fire late; refreshes missed in between are skipped rather than caught up
+        self.last_refresh_time = None
+
         self.screen = CHIP8GameScreen(SCALING_FACTOR)
 
         self.load_rom_action = LoadROMAction(self)
         self.toggle_break_mode_action = ToggleBreakModeAction(self)
         self.toggle_debug_mode_action = ToggleDebugMode(self)
+        self.record_movie_action = RecordMovieAction(self)
+        self.play_movie_action = PlayMovieAction(self)
+        self.toggle_run_ahead_action = ToggleRunAheadAction(self)
 
         self.main_window = CHIP8MainWindow(
             self.screen,
-            [self.load_rom_action, self.toggle_break_mode_action, self.toggle_debug_mode_action],
+            [self.load_rom_action, self.toggle_break_mode_action, self.toggle_debug_mode_action,
+             self.record_movie_action, self.play_movie_action, self.toggle_run_ahead_action],
             self.execution_mode
         )
 
@@ -44,15 +64,81 @@ class CHIP8App(QApplication):
             debug_window.setVisible(self.execution_mode != ExecutionMode.NORMAL)
 
     def refresh(self):
-        for _ in range(INSTRUCTIONS_PER_REFRESH):
-            # always run the debugger even in non-debug mode to store previous states
-            debugger.run_one()
-        machine.decrement_timers(TIMER_DECREMENTS_PER_REFRESH)
+        now = time.perf_counter()
+        if self.last_refresh_time is not None:
+            skipped = max(int((now - self.last_refresh_time) * 1000 / MILLISECONDS_PER_REFRESH) - 1, 0)
+            telemetry.add_frames(1, skipped)
+            telemetry.add_missed_timer_ticks(skipped * TIMER_DECREMENTS_PER_REFRESH)
+        else:
+            telemetry.add_frames(1, 0)
+        self.last_refresh_time = now
+
+        # the views render from inside the frame; their time is counted separately
+        render_time_before = telemetry.read().render_time
+
+        if self.player is not None:
+            executed = self.player.run_frames(1).instructions_executed
+            if self.player.finished:
+                self.player = None
+            self.screen.refresh()
+        else:
+            # always run the debugger even in non-debug mode to store previous states; the whole frame runs natively
+            # without the GIL and views are notified once at the end
+            executed = debugger.run_frames(1).instructions_executed
+            # a movie's input is known in advance, so only live play has lag to hide
+            if run_ahead.update():
+                self.screen.refresh()
+
+        counters = telemetry.read()
+        elapsed = timedelta(seconds=time.perf_counter() - now) - (counters.render_time - render_time_before)
+        telemetry.add_execution(executed, elapsed)
+
+        if counters.frames_produced % SCREEN_REFRESHES_PER_SECOND == 0:
+            self.main_window.show_telemetry(counters)
 
     def load_rom(self):
         rom_name, _ = QFileDialog.getOpenFileName(self.main_window, "Open ROM", "")
         if rom_name:
+            self.rom_name = rom_name
+            self.recorder = None
+            self.player = None
+            self.record_movie_action.refresh_name()
             machine.load_program_from_bytes(get_bytes(rom_name))
+            self.refresh_views()
+
+    def refresh_views(self):
+        # loading a program raises no events, so the views are refreshed by hand
+        self.screen.refresh()
+        for debug_window in self.extra_debug_windows:
+            debug_window.refresh()
+
+    def toggle_recording(self):
+        if self.recorder is not None:
+            movie_name, _ = QFileDialog.getSaveFileName(self.main_window, "Save Movie", "")
+            if movie_name:
+                save_movie(self.recorder.movie, movie_name)
+            self.recorder = None
+        elif self.rom_name:
+            # movies start from a freshly loaded ROM
+            self.player = None
+            machine.load_program_from_bytes(get_bytes(self.rom_name))
+            self.refresh_views()
+            self.recorder = MovieRecorder(machine, random.getrandbits(32))
+
+    def play_movie(self):
+        if not self.rom_name:
+            return
+        movie_name, _ = QFileDialog.getOpenFileName(self.main_window, "Play Movie", "")
+        if movie_name:
+            self.recorder = None
+            self.record_movie_action.refresh_name()
+            machine.load_program_from_bytes(get_bytes(self.rom_name))
+            self.refresh_views()
+            self.player = MoviePlayer(machine, load_movie(movie_name))
+
+    def toggle_run_ahead(self):
+        run_ahead.frames = RUN_AHEAD_FRAMES if run_ahead.frames == 0 else 0
+        self.screen.refresh()
 
     def toggle_break_mode(self):
         previous_execution_mode = self.execution_mode
@@ -63,6 +149,7 @@ class CHIP8App(QApplication):
         else:
             self.execution_mode = ExecutionMode.BREAK
             self.refresh_timer.stop()
+            self.last_refresh_time = None
         self.previous_execution_mode = previous_execution_mode
 
         self.main_window.set_execution_mode(self.execution_mode)
@@ -94,9 +181,6 @@ class CHIP8MainWindow(QMainWindow):
         self.game_screen = game_screen
 
         self.execution_mode = execution_mode
-        # Number of instructions executed in debug mode since last refresh. Since time doesn't flow in debug mode,
-        # we use this to determine how much time has passed.
-        self.ins_executed_since_refresh = 0
 
         self.toolbar = CHIP8ToolBar(actions)
         self.addToolBar(self.toolbar)
@@ -107,27 +191,29 @@ class CHIP8MainWindow(QMainWindow):
     def set_execution_mode(self, mode):
         self.execution_mode = mode
 
+    def show_telemetry(self, counters):
+        frames = max(counters.frames_produced, 1)
+        self.statusBar().showMessage(
+            f"{counters.instructions_per_second:.0f} IPS, {counters.frames_produced} frames, "
+            f"{counters.frames_skipped} skipped, {counters.timer_ticks_missed} timer ticks missed, "
+            f"execute {counters.execute_time.total_seconds() * 1000 / frames:.3f} ms, "
+            f"render {counters.render_time.total_seconds() * 1000 / frames:.3f} ms per frame"
+        )
+
     def debugger_go_forward(self):
         assert self.execution_mode == ExecutionMode.BREAK, "Step-by-step execution is only available in BREAK mode."
 
+        # the timers run on the machine's cycles, so they keep time with the steps
         debugger.run_one()
 
-        self.ins_executed_since_refresh += 1
-        self.ins_executed_since_refresh %= INSTRUCTIONS_PER_REFRESH
-        if self.ins_executed_since_refresh == 0:
-            machine.decrement_timers(TIMER_DECREMENTS_PER_REFRESH)
-
     def debugger_go_back(self):
         assert self.execution_mode == ExecutionMode.BREAK, "Step-by-step execution is only available in BREAK mode."
 
         debugger.go_back_one()
 
-        self.ins_executed_since_refresh -= 1
-        self.ins_executed_since_refresh %= INSTRUCTIONS_PER_REFRESH
-
     def keyPressEvent(self, event):
         key = event.key()
-        if key in KBD_TO_CHIP_8:
+        if key in KBD_TO_CHIP_8 and QApplication.instance().player is None:
             machine.keyboard.set_key_pressed(KBD_TO_CHIP_8[key])
         if self.execution_mode:
             if key == DEBUG_GO_FORWARD_KEY:
@@ -136,7 +222,7 @@ class CHIP8MainWindow(QMainWindow):
                 self.debugger_go_back()
 
     def keyReleaseEvent(self, event):
-        if (key := event.key()) in KBD_TO_CHIP_8:
+        if (key := event.key()) in KBD_TO_CHIP_8 and QApplication.instance().player is None:
             machine.keyboard.set_key_released(KBD_TO_CHIP_8[key])
 
 
@@ -151,22 +237,26 @@ class CHIP8GameScreen(QGraphicsView):
     def __init__(self, scaling_factor):
         super().__init__()
 
-        debugger.on_exec(self.refresh_if_needed)
+        # at most one redraw per frame, and only if an instruction changed the screen
+        debugger.subscribe([DebugEventKind.FRAME_CHANGED], lambda _: self.refresh())
+        debugger.on_exec(self.refresh_after_going_back)
 
         self.game_scene = CHIP8GameScreenScene()
         self.setScene(self.game_scene)
 
-        width = len(machine.frame_buffer)
-        height = len(machine.frame_buffer[0])
-
-        self.setMinimumSize(width * (scaling_factor + 1), height * (scaling_factor + 1))
+        self.setMinimumSize(FRAME_BUFFER_WIDTH * (scaling_factor + 1), FRAME_BUFFER_HEIGHT * (scaling_factor + 1))
         self.scale(scaling_factor, scaling_factor)
 
-    def refresh_if_needed(self, _, instruction):
-        if not affects_screen(instruction):
-            return
+    def refresh_after_going_back(self, event, _):
+        # no event reports what going back undoes
+        if event == ExecutionEvent.GO_BACK_ONE:
+            self.refresh()
+
+    def refresh(self):
+        start = time.perf_counter()
         self.game_scene.refresh()
         self.update()
+        telemetry.add_render(timedelta(seconds=time.perf_counter() - start))
 
 
 class CHIP8GameScreenScene(QGraphicsScene):
@@ -177,7 +267,8 @@ class CHIP8GameScreenScene(QGraphicsScene):
     def refresh(self):
         self.clear()
 
-        item = get_graphics_from_frame_buffer(machine.frame_buffer)
+        # the machine's own screen unless running ahead
+        item = get_graphics_from_frame_buffer(run_ahead.frame_buffer)
         self.addItem(item)
 
         self.update()
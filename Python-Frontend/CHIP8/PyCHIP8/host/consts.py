@@ -7,6 +7,9 @@ from PyCHIP8.PyCHIP8 import Key
 
 SCALING_FACTOR = 10
 
+# frames the screen is shown ahead of the machine while running ahead, enough to hide most ROMs' lag
+RUN_AHEAD_FRAMES = 1
+
 KBD_TO_CHIP_8 = {
     Qt.Key.Key_X: Key.K0,
     Qt.Key.Key_1: Key.K1,
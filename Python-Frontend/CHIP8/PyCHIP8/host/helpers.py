@@ -1,7 +1,7 @@
 from PySide6.QtGui import QPixmap, QImage
 from PySide6.QtWidgets import QGraphicsPixmapItem
 
-from PyCHIP8.PyCHIP8 import MAX_NUM_INSTURCTIONS, INSTRUCTION_SIZE
+from PyCHIP8.PyCHIP8 import MAX_NUM_INSTURCTIONS, INSTRUCTION_SIZE, FRAME_BUFFER_WIDTH, FRAME_BUFFER_HEIGHT, render_rgba
 
 
 def get_bytes(filename):
@@ -16,31 +16,9 @@ def get_bytes(filename):
 
 
 def get_graphics_from_frame_buffer(frame_buffer):
-    width = len(frame_buffer)
-    height = len(frame_buffer[0])
-
-    img = QImage(width, height, QImage.Format.Format_Mono)
-    for x, row in enumerate(frame_buffer):
-        for y, pixel in enumerate(row):
-            img.setPixel(x, y, 0 if pixel else 1)
+    # the core draws the image, QImage only wraps it until the pixmap copies it
+    pixels = render_rgba(frame_buffer)
+    img = QImage(pixels, FRAME_BUFFER_WIDTH, FRAME_BUFFER_HEIGHT, QImage.Format.Format_RGBA8888)
 
     pixmap = QPixmap.fromImage(img)
     return QGraphicsPixmapItem(pixmap)
-
-
-def affects_registers(instruction):
-    return instruction.category in {
-        0x6, 0x7, 0x8, 0xA, 0xC, 0xD, 0xF,
-    }
-
-
-def affects_memory(instruction):
-    return instruction.category in {
-        0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x9, 0xB, 0xE,
-    }
-
-
-def affects_screen(instruction):
-    return instruction.category in {
-        0xD,
-    }
@@ -1,14 +1,166 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <pybind11/functional.h>
+#include <pybind11/chrono.h>
+#include <pybind11/operators.h>
+#include <pybind11/numpy.h>
+
+#include <array>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
 
 #include "CHIP-8.hpp"
 #include "keyboard.hpp"
 #include "machine-specs.hpp"
 #include "debugger.hpp"
+#include "compiled-program.hpp"
+#include "frame-runner.hpp"
+#include "movie.hpp"
+#include "telemetry.hpp"
+#include "session-host.hpp"
+#include "run-ahead.hpp"
+#include "render.hpp"
+#include "vector-environment.hpp"
 
 namespace py = pybind11;
 
+// Colors are (r, g, b, a) tuples in Python.
+using Color = std::array<byte, RGBA_BYTES_PER_PIXEL>;
+
+static Rgba to_rgba(const Color& color)
+{
+	return Rgba{ color[0], color[1], color[2], color[3] };
+}
+
+static Color to_color(const Rgba& rgba)
+{
+	return Color{ rgba.r, rgba.g, rgba.b, rgba.a };
+}
+
+static bool is_contiguous(const py::buffer_info& info)
+{
+	auto stride = info.itemsize;
+	for (auto d = info.ndim; d-- > 0;)
+	{
+		if (info.shape[d] != 1 && info.strides[d] != stride)
+		{
+			return false;
+		}
+		stride *= info.shape[d];
+	}
+	return true;
+}
+
+/**
+ * Calls `render` with `size` bytes to draw into: those of `out`, which must be
+ * a writable, contiguous buffer at least that large, or else of a new bytes
+ * object. Returns what was drawn into. The GIL is released while drawing.
+ */
+template <typename F>
+static py::object render_into(size_t size, const py::object& out, F render)
+{
+	if (size == 0)
+	{
+		throw py::value_error("scale must be at least 1");
+	}
+
+	if (out.is_none())
+	{
+		auto image = py::reinterpret_steal<py::bytes>(PyBytes_FromStringAndSize(nullptr, static_cast<py::ssize_t>(size)));
+		if (!image)
+		{
+			throw py::error_already_set();
+		}
+
+		const auto pixels = reinterpret_cast<byte*>(PyBytes_AsString(image.ptr()));
+		{
+			py::gil_scoped_release release;
+			render(pixels);
+		}
+		return image;
+	}
+
+	const auto info = py::reinterpret_borrow<py::buffer>(out).request(true);
+	if (!is_contiguous(info) || static_cast<size_t>(info.size * info.itemsize) < size)
+	{
+		throw py::value_error("out must be a contiguous buffer of at least " + std::to_string(size) + " bytes");
+	}
+
+	{
+		py::gil_scoped_release release;
+		render(static_cast<byte*>(info.ptr));
+	}
+	return out;
+}
+
+/**
+ * Deletes a Session_host for Python. Its workers may be waiting for the GIL to
+ * call the deadline callback, so they are stopped with the GIL released; the
+ * host itself, and with it the callback, is then destroyed with the GIL held.
+ */
+struct Session_host_deleter
+{
+	void operator()(Session_host* host) const
+	{
+		{
+			py::gil_scoped_release release;
+			host->stop();
+		}
+		delete host;
+	}
+};
+
+/**
+ * A Vector_environment and NumPy views of its buffers, which are made once so
+ * that steps allocate nothing. The views keep the environment alive on their
+ * own, so they stay valid after the environment is gone in Python.
+ */
+struct Python_vector_environment
+{
+	using Fault_code_value = std::underlying_type_t<Fault_code>;
+
+	Python_vector_environment(const std::array<byte, MAX_NUM_INSTRUCTIONS * INSTRUCTION_SIZE>& program,
+		size_t num_machines, size_t num_threads, size_t frames_per_step, std::uint32_t seed)
+		: environment{ std::make_shared<Vector_environment>(program, num_machines, num_threads, frames_per_step, seed) },
+		observations{ make_view(environment->get_observations(), { size(), FRAME_BUFFER_HEIGHT, FRAME_BUFFER_WIDTH }) },
+		done{ make_view(environment->get_done(), { size() }) },
+		faults{ make_view(reinterpret_cast<const Fault_code_value*>(environment->get_faults()), { size() }) },
+		results{ py::make_tuple(observations, done, faults) }
+	{
+	}
+
+	py::ssize_t size() const
+	{
+		return static_cast<py::ssize_t>(environment->size());
+	}
+
+	// Read-only, since the environment writes to them on every step.
+	template <typename T>
+	py::array_t<T> make_view(const T* data, std::vector<py::ssize_t> shape) const
+	{
+		const py::capsule owner{ new std::shared_ptr<Vector_environment>{ environment }, [](void* owned)
+		{
+			delete static_cast<std::shared_ptr<Vector_environment>*>(owned);
+		} };
+
+		py::array_t<T> view{ std::move(shape), data, owner };
+		view.attr("flags").attr("writeable") = false;
+		return view;
+	}
+
+	std::shared_ptr<Vector_environment> environment;
+	py::array_t<byte> observations;
+	py::array_t<bool> done;
+	py::array_t<Fault_code_value> faults;
+
+	// What step returns: the views above, every time.
+	py::tuple results;
+};
+
 PYBIND11_MODULE(PyCHIP8, m)
 {
 	m.doc() = "CHIP-8 emulator library";
@@ -18,10 +170,26 @@ PYBIND11_MODULE(PyCHIP8, m)
 		.def("load_program", &CHIP_8::load_program)
 		.def("load_program_from_bytes", &CHIP_8::load_program_from_bytes)
 		.def("run_one", &CHIP_8::run_one)
+		.def("run_one_or_throw", &CHIP_8::run_one_or_throw)
+		.def("run", &CHIP_8::run, py::call_guard<py::gil_scoped_release>())
+		.def("run_frames", &CHIP_8::run_frames, py::call_guard<py::gil_scoped_release>())
+		.def_property_readonly("cycle_count", &CHIP_8::get_cycle_count)
+		.def_property_readonly("fault", &CHIP_8::get_fault)
+		.def_property_readonly("waiting_for_key", &CHIP_8::is_waiting_for_key)
+		.def("seed_random", &CHIP_8::seed_random)
+		.def("take_snapshot", &CHIP_8::take_snapshot)
+		.def("restore_snapshot", &CHIP_8::restore_snapshot)
+		.def("set_compiled_program", &CHIP_8::set_compiled_program, py::keep_alive<1, 2>())
 		.def_property_readonly("frame_buffer", &CHIP_8::get_frame_buffer)
-		.def("decrement_timers", &CHIP_8::decrement_timers)
+		.def_property_readonly("delay_timer", &CHIP_8::get_delay_timer)
+		.def_property_readonly("sound_timer", &CHIP_8::get_sound_timer)
 		.def_readonly("keyboard", &CHIP_8::keyboard);
 
+	py::class_<CHIP_8::Snapshot>(m, "Snapshot");
+
+	py::class_<Compiled_program>(m, "CompiledProgram")
+		.def(py::init<const std::string&>());
+
 	py::class_<Debugger>(m, "Debugger")
 		.def(py::init<CHIP_8&>())
 		.def("run_one", &Debugger::run_one)
@@ -35,19 +203,225 @@ PYBIND11_MODULE(PyCHIP8, m)
 		.def_property("index_register", &Debugger::get_index_register,
 					  &Debugger::set_index_register)
 		.def("on_exec", &Debugger::on_exec)
+		// Callbacks registered with on_frame take the GIL back when they are called.
+		.def("run_frames", &Debugger::run_frames, py::call_guard<py::gil_scoped_release>())
+		.def("on_frame", &Debugger::on_frame)
+		.def("subscribe",
+			 [](Debugger& debugger, const std::vector<Debug_event_kind>& kinds,
+				const std::function<void(const std::vector<Debug_event>&)>& f, bool batched,
+				double_byte memory_start, double_byte memory_end, std::uint32_t registers)
+			 {
+				 auto filter = Debug_filter{ 0, memory_start, memory_end, registers, batched };
+				 for (const auto kind : kinds)
+				 {
+					 filter.kinds |= 1 << static_cast<int>(kind);
+				 }
+				 debugger.subscribe(filter, f);
+			 },
+			 py::arg("kinds"), py::arg("callback"), py::arg("batched") = true, py::arg("memory_start") = 0,
+			 py::arg("memory_end") = MEMORY_SIZE, py::arg("registers") = ALL_REGISTERS)
+		.def("take_memory_changes", &Debugger::take_memory_changes)
+		.def("take_register_changes", &Debugger::take_register_changes)
 		.def("run_one_without_callback", &Debugger::run_one_without_callback)
 		.def("go_back_one_without_callback", &Debugger::go_back_one_without_callback);
 
+	py::class_<Frame_runner>(m, "FrameRunner")
+		.def(py::init<CHIP_8&, size_t>(), py::arg("machine"),
+			 py::arg("instructions_per_frame") = INSTRUCTIONS_PER_REFRESH, py::keep_alive<1, 2>())
+		.def("start", &Frame_runner::start)
+		.def("stop", &Frame_runner::stop, py::call_guard<py::gil_scoped_release>())
+		.def_property_readonly("running", &Frame_runner::is_running)
+		.def("set_key_pressed", &Frame_runner::set_key_pressed, py::call_guard<py::gil_scoped_release>())
+		.def("set_key_released", &Frame_runner::set_key_released, py::call_guard<py::gil_scoped_release>())
+		.def_property_readonly("frame_count", &Frame_runner::get_frame_count)
+		.def_property_readonly("status", &Frame_runner::get_status)
+		.def_property_readonly("frame_buffer", &Frame_runner::get_frame_buffer)
+		.def_property_readonly("telemetry", &Frame_runner::get_telemetry);
+
+	py::class_<Run_ahead>(m, "RunAhead")
+		.def(py::init<CHIP_8&, size_t>(), py::arg("machine"), py::arg("frames") = 0, py::keep_alive<1, 2>())
+		.def("update", &Run_ahead::update, py::call_guard<py::gil_scoped_release>())
+		.def_property("frames", &Run_ahead::get_frames, &Run_ahead::set_frames)
+		.def_property_readonly("frame_buffer", &Run_ahead::get_frame_buffer);
+
+	// Keys are an array of N masks, with bit k set to press key k. Observations
+	// are an (N, 32, 64) array of 0s and 1s, done is set for machines which
+	// finished or faulted, and faults holds their FaultCode values.
+	py::class_<Python_vector_environment>(m, "VectorEnvironment")
+		.def(py::init<const std::array<byte, MAX_NUM_INSTRUCTIONS * INSTRUCTION_SIZE>&, size_t, size_t, size_t, std::uint32_t>(),
+			 py::arg("program"), py::arg("num_machines"), py::arg("num_threads") = std::thread::hardware_concurrency(),
+			 py::arg("frames_per_step") = 1, py::arg("seed") = DEFAULT_RANDOM_SEED)
+		.def("step", [](Python_vector_environment& self, const py::array_t<Key_mask, py::array::c_style | py::array::forcecast>& keys)
+		{
+			if (keys.ndim() != 1 || static_cast<size_t>(keys.size()) != self.environment->size())
+			{
+				throw py::value_error("keys must hold one mask per machine");
+			}
+
+			{
+				py::gil_scoped_release release;
+				self.environment->step(keys.data());
+			}
+			return self.results;
+		}, py::arg("keys"))
+		// Resets the machines whose entries in `which` are true, or all of them.
+		.def("reset", [](Python_vector_environment& self, const std::optional<py::array_t<bool, py::array::c_style | py::array::forcecast>>& which)
+		{
+			if (which && (which->ndim() != 1 || static_cast<size_t>(which->size()) != self.environment->size()))
+			{
+				throw py::value_error("which must hold one flag per machine");
+			}
+
+			{
+				py::gil_scoped_release release;
+				self.environment->reset(which ? which->data() : nullptr);
+			}
+			return self.results;
+		}, py::arg("which") = py::none())
+		.def("__len__", [](const Python_vector_environment& self) { return self.environment->size(); })
+		.def_property_readonly("frames_per_step", [](const Python_vector_environment& self) { return self.environment->get_frames_per_step(); })
+		.def_readonly("observations", &Python_vector_environment::observations)
+		.def_readonly("done", &Python_vector_environment::done)
+		.def_readonly("faults", &Python_vector_environment::faults)
+		.def("machine", [](Python_vector_environment& self, size_t i) -> CHIP_8&
+		{
+			if (i >= self.environment->size())
+			{
+				throw py::index_error("no such machine");
+			}
+			return self.environment->get_machine(i);
+		}, py::return_value_policy::reference, py::keep_alive<0, 1>());
+
+	py::class_<Session_host, std::unique_ptr<Session_host, Session_host_deleter>>(m, "SessionHost")
+		.def(py::init<size_t, size_t>(), py::arg("num_workers") = std::thread::hardware_concurrency(),
+			 py::arg("instructions_per_frame") = INSTRUCTIONS_PER_REFRESH)
+		.def("add_session", &Session_host::add_session, py::keep_alive<1, 2>())
+		.def("remove_session", &Session_host::remove_session, py::call_guard<py::gil_scoped_release>())
+		.def_property_readonly("num_sessions", &Session_host::get_num_sessions)
+		.def("start", &Session_host::start)
+		.def("stop", &Session_host::stop, py::call_guard<py::gil_scoped_release>())
+		.def_property_readonly("running", &Session_host::is_running)
+		.def("set_key_pressed", &Session_host::set_key_pressed, py::call_guard<py::gil_scoped_release>())
+		.def("set_key_released", &Session_host::set_key_released, py::call_guard<py::gil_scoped_release>())
+		.def("get_frame_buffer", &Session_host::get_frame_buffer, py::call_guard<py::gil_scoped_release>())
+		.def("get_stats", &Session_host::get_stats)
+		// The callback runs on a worker thread and takes the GIL when it is called.
+		.def("on_deadline_missed", &Session_host::on_deadline_missed);
+
+	py::class_<Session_stats>(m, "SessionStats")
+		.def_readonly("frames", &Session_stats::frames)
+		.def_readonly("deadlines_missed", &Session_stats::deadlines_missed)
+		.def_readonly("frames_skipped", &Session_stats::frames_skipped)
+		.def_readonly("status", &Session_stats::status);
+
+	py::class_<Telemetry>(m, "Telemetry")
+		.def(py::init())
+		.def("add_execution", &Telemetry::add_execution)
+		.def("add_render", &Telemetry::add_render)
+		.def("add_frames", &Telemetry::add_frames)
+		.def("add_missed_timer_ticks", &Telemetry::add_missed_timer_ticks)
+		.def("read", &Telemetry::read);
+
+	py::class_<Telemetry_counters>(m, "TelemetryCounters")
+		.def_readonly("instructions_executed", &Telemetry_counters::instructions_executed)
+		.def_readonly("instructions_per_second", &Telemetry_counters::instructions_per_second)
+		.def_readonly("frames_produced", &Telemetry_counters::frames_produced)
+		.def_readonly("frames_skipped", &Telemetry_counters::frames_skipped)
+		.def_readonly("timer_ticks_missed", &Telemetry_counters::timer_ticks_missed)
+		.def_readonly("execute_time", &Telemetry_counters::execute_time)
+		.def_readonly("render_time", &Telemetry_counters::render_time);
+
+	py::class_<Movie>(m, "Movie")
+		.def_readonly("seed", &Movie::seed)
+		.def_readonly("end_cycle", &Movie::end_cycle);
+
+	m.def("load_movie", [](const std::string& path)
+	{
+		std::ifstream stream{ path, std::ios::binary };
+		return load_movie(stream);
+	});
+	m.def("save_movie", [](const Movie& movie, const std::string& path)
+	{
+		std::ofstream stream{ path, std::ios::binary };
+		save_movie(movie, stream);
+	});
+
+	py::class_<Movie_recorder>(m, "MovieRecorder")
+		.def(py::init<CHIP_8&, std::uint32_t>(), py::keep_alive<1, 2>())
+		.def_property_readonly("movie", &Movie_recorder::get_movie);
+
+	py::class_<Movie_player>(m, "MoviePlayer")
+		.def(py::init<CHIP_8&, const Movie&>(), py::keep_alive<1, 2>())
+		.def("run", &Movie_player::run, py::call_guard<py::gil_scoped_release>())
+		.def("run_frames", &Movie_player::run_frames, py::call_guard<py::gil_scoped_release>())
+		.def_property_readonly("finished", &Movie_player::is_finished);
+
 	py::class_<Keyboard>(m, "Keyboard")
 		.def(py::init())
 		.def("set_key_pressed", &Keyboard::set_key_pressed)
 		.def("set_key_released", &Keyboard::set_key_released)
 		.def("is_key_pressed", &Keyboard::is_key_pressed);
 
+	py::class_<Frame_buffer>(m, "FrameBuffer")
+		.def_readonly("rows", &Frame_buffer::rows)
+		.def("get_pixel", &Frame_buffer::get_pixel)
+		.def(py::self == py::self);
+
+	// The images can be handed to QImage as Format_RGBA8888 and Format_Mono.
+	m.def("render_rgba", [](const Frame_buffer& frame_buffer, size_t scale, const Color& off, const Color& on, const py::object& out)
+	{
+		const auto palette = Palette{ to_rgba(off), to_rgba(on) };
+		return render_into(get_rgba_image_size(scale), out, [&](byte* pixels)
+		{
+			render_rgba(frame_buffer, palette, scale, pixels);
+		});
+	}, py::arg("frame_buffer"), py::arg("scale") = 1, py::arg("off") = to_color(DEFAULT_PALETTE.off),
+		py::arg("on") = to_color(DEFAULT_PALETTE.on), py::arg("out") = py::none());
+	m.def("render_mono", [](const Frame_buffer& frame_buffer, size_t scale, const py::object& out)
+	{
+		return render_into(get_mono_image_size(scale), out, [&](byte* pixels)
+		{
+			render_mono(frame_buffer, scale, pixels);
+		});
+	}, py::arg("frame_buffer"), py::arg("scale") = 1, py::arg("out") = py::none());
+
 	py::class_<Instruction>(m, "Instruction")
 		.def_readonly("raw", &Instruction::raw_instruction)
 		.def_readonly("category", &Instruction::category);
 
+	py::class_<Fault>(m, "Fault")
+		.def_readonly("code", &Fault::code)
+		.def_readonly("pc", &Fault::pc)
+		.def_readonly("instruction", &Fault::instruction);
+
+	py::class_<Run_result>(m, "RunResult")
+		.def_readonly("instructions_executed", &Run_result::instructions_executed)
+		.def_readonly("status", &Run_result::status);
+
+	py::class_<Memory_change>(m, "MemoryChange")
+		.def_readonly("address", &Memory_change::address)
+		.def_readonly("old_value", &Memory_change::old_value)
+		.def_readonly("new_value", &Memory_change::new_value);
+
+	py::class_<Register_change>(m, "RegisterChange")
+		.def_readonly("id", &Register_change::id)
+		.def_readonly("old_value", &Register_change::old_value)
+		.def_readonly("new_value", &Register_change::new_value);
+
+	py::class_<Debug_event>(m, "DebugEvent")
+		.def_readonly("kind", &Debug_event::kind)
+		.def_readonly("cycle", &Debug_event::cycle)
+		.def_readonly("pc", &Debug_event::pc)
+		.def_readonly("instruction", &Debug_event::instruction)
+		.def_readonly("address", &Debug_event::address)
+		.def_readonly("length", &Debug_event::length)
+		.def_readonly("registers", &Debug_event::registers);
+
+	py::class_<Frame_report>(m, "FrameReport")
+		.def_readonly("instructions_executed", &Frame_report::instructions_executed)
+		.def_readonly("status", &Frame_report::status)
+		.def_readonly("categories", &Frame_report::categories);
+
 	py::enum_<Key>(m, "Key")
 		.value("K0", Key::K0)
 		.value("K1", Key::K1)
@@ -68,14 +442,39 @@ PYBIND11_MODULE(PyCHIP8, m)
 		.value("NONE", Key::NONE)
 		.export_values();
 
+	py::enum_<Debug_event_kind>(m, "DebugEventKind")
+		.value("FRAME_CHANGED", Debug_event_kind::FRAME_CHANGED)
+		.value("MEMORY_WRITE", Debug_event_kind::MEMORY_WRITE)
+		.value("REGISTER_WRITE", Debug_event_kind::REGISTER_WRITE)
+		.value("CALL", Debug_event_kind::CALL)
+		.value("RETURN", Debug_event_kind::RETURN)
+		.value("KEY_WAIT", Debug_event_kind::KEY_WAIT);
+
 	py::enum_<Execution_event>(m, "ExecutionEvent")
 		.value("RUN_ONE", Execution_event::RUN_ONE)
 		.value("GO_BACK_ONE", Execution_event::GO_BACK_ONE)
 		.export_values();
 
+	py::enum_<Fault_code>(m, "FaultCode")
+		.value("NONE", Fault_code::NONE)
+		.value("INVALID_INSTRUCTION", Fault_code::INVALID_INSTRUCTION)
+		.value("STACK_OVERFLOW", Fault_code::STACK_OVERFLOW)
+		.value("STACK_UNDERFLOW", Fault_code::STACK_UNDERFLOW)
+		.value("INVALID_KEY", Fault_code::INVALID_KEY);
+
+	py::enum_<Run_status>(m, "RunStatus")
+		.value("RUNNING", Run_status::RUNNING)
+		.value("FINISHED", Run_status::FINISHED)
+		.value("FAULTED", Run_status::FAULTED)
+		.value("WAITING_FOR_KEY", Run_status::WAITING_FOR_KEY);
+
 	m.attr("MILLISECONDS_PER_REFRESH") = MILLISECONDS_PER_REFRESH;
 	m.attr("INSTRUCTIONS_PER_REFRESH") = INSTRUCTIONS_PER_REFRESH;
 	m.attr("TIMER_DECREMENTS_PER_REFRESH") = TIMER_DECREMENTS_PER_REFRESH;
+	m.attr("CYCLES_PER_TIMER_TICK") = CYCLES_PER_TIMER_TICK;
+	m.attr("SCREEN_REFRESHES_PER_SECOND") = SCREEN_REFRESHES_PER_SECOND;
+	m.attr("FRAME_BUFFER_WIDTH") = FRAME_BUFFER_WIDTH;
+	m.attr("FRAME_BUFFER_HEIGHT") = FRAME_BUFFER_HEIGHT;
 	m.attr("MAX_NUM_INSTURCTIONS") = MAX_NUM_INSTRUCTIONS;
 	m.attr("INSTRUCTION_SIZE") = INSTRUCTION_SIZE;
 }
\ No newline at end of file
@@ -0,0 +1,299 @@
+#include <iostream>
+#include <fstream>
+#include <array>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <new>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#include "CHIP-8.hpp"
+#include "debugger.hpp"
+#include "run-ahead.hpp"
+#include "vector-environment.hpp"
+#include "helpers.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+
+using std::cout;
+using std::cerr;
+using std::ifstream;
+using std::ios;
+using std::array;
+using std::vector;
+using std::string;
+using std::size_t;
+
+/**
+ * Checks that executing instructions never allocates. Every operator new in
+ * the program goes through a counter, which is only switched on around
+ * execution, never around setting a machine up.
+ *
+ * Each of the 65536 instruction words is executed on its own through
+ * CHIP_8::run_one, CHIP_8::run, Debugger::run_one and CHIP_8::run followed by
+ * running ahead. ROMs given on the command line additionally run for a
+ * minute's worth of refreshes through each path, which covers the fused and
+ * skipped idioms, and for as many steps of a Vector_environment. Exits with 1
+ * if anything allocated.
+ *
+ * Running ahead only avoids allocating once its snapshots are the only ones
+ * holding the machine's pages, as in a frontend. So for that path the machine
+ * is loaded from scratch rather than restored, and runs ahead once before
+ * counting starts.
+ */
+
+// The workers of a Vector_environment allocate on their own threads.
+static std::atomic<bool> counting = false;
+static std::atomic<size_t> num_allocations = 0;
+
+// The array and nothrow forms of new and delete go through these by default.
+void* operator new(size_t size)
+{
+	if (counting)
+	{
+		++num_allocations;
+	}
+
+	if (void* p = std::malloc(size != 0 ? size : 1))
+	{
+		return p;
+	}
+
+	throw std::bad_alloc{};
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	if (counting)
+	{
+		++num_allocations;
+	}
+
+	// aligned_alloc wants a size which is a multiple of the alignment, and
+	// isn't available on Windows.
+	const auto align = static_cast<size_t>(alignment);
+	const auto rounded = (size + align - 1) / align * align;
+#ifdef _WIN32
+	void* p = _aligned_malloc(rounded != 0 ? rounded : align, align);
+#else
+	void* p = std::aligned_alloc(align, rounded != 0 ? rounded : align);
+#endif
+	if (p != nullptr)
+	{
+		return p;
+	}
+
+	throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	std::free(p);
+#endif
+}
+
+void operator delete(void* p, size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(p, alignment);
+}
+
+template <typename Function>
+size_t count_allocations(Function&& f)
+{
+	num_allocations = 0;
+	counting = true;
+	f();
+	counting = false;
+
+	return num_allocations;
+}
+
+enum class Path
+{
+	RUN_ONE, RUN, DEBUGGER, RUN_AHEAD
+};
+
+constexpr Path PATHS[] = { Path::RUN_ONE, Path::RUN, Path::DEBUGGER, Path::RUN_AHEAD };
+constexpr const char* PATH_NAMES[] = { "run_one", "run", "Debugger::run_one", "Run_ahead::update" };
+
+// Vector_environment runs programs of its own, so it is only checked on ROMs.
+constexpr auto VECTOR_ENVIRONMENT_PATH_NAME = "Vector_environment::step";
+
+constexpr auto NUM_ENVIRONMENT_MACHINES = 4;
+constexpr auto NUM_ENVIRONMENT_THREADS = 2;
+
+constexpr auto SECONDS_PER_ROM = 60;
+
+int main(int argc, char* argv[])
+{
+	static CHIP_8 machine;
+	Debugger debugger{ machine };
+
+	// Stepping through the debugger also calls back into the host, both for
+	// every instruction and for the events of subscribers.
+	size_t num_events = 0;
+	debugger.on_exec([&num_events](Execution_event, const Instruction&) { ++num_events; });
+
+	const auto count_events = [&num_events](const vector<Debug_event>& events) { num_events += events.size(); };
+	debugger.subscribe(Debug_filter{ 0xFF, 0, MEMORY_SIZE, ALL_REGISTERS, true }, count_events);
+	debugger.subscribe(Debug_filter{ 0xFF, 0, MEMORY_SIZE, ALL_REGISTERS, false }, count_events);
+
+	Run_ahead run_ahead{ machine, 2 };
+
+	const auto clean_state = machine.take_snapshot();
+	bool allocated = false;
+
+	const auto set_up = [&clean_state](Path path)
+	{
+		if (path == Path::RUN_AHEAD)
+		{
+			machine.load_program_from_bytes({});
+		}
+		else
+		{
+			machine.restore_snapshot(clean_state);
+		}
+	};
+	const auto warm_up = [&run_ahead](Path path)
+	{
+		if (path == Path::RUN_AHEAD)
+		{
+			run_ahead.update();
+		}
+	};
+
+	const auto report = [&allocated](const string& what, const char* path_name, size_t allocations)
+	{
+		if (allocations > 0)
+		{
+			cout << what << ": " << allocations << " allocations in " << path_name << '\n';
+			allocated = true;
+		}
+	};
+
+	for (std::uint32_t word = 0; word <= 0xFFFF; ++word)
+	{
+		for (const auto path : PATHS)
+		{
+			// Registers hold a spread of values, so that both outcomes of
+			// skips and carries come up across the instructions.
+			set_up(path);
+			for (size_t i = 0; i < NUM_REGISTERS; ++i)
+			{
+				debugger.set_register(i, static_cast<byte>(word * 7 + i * 37));
+			}
+			debugger.set_index_register(0x300);
+
+			const byte bytes[] = { static_cast<byte>(word >> BITS_PER_BYTE), static_cast<byte>(word) };
+			machine.write_program(bytes, sizeof(bytes));
+			warm_up(path);
+
+			const auto allocations = count_allocations([&]
+			{
+				switch (path)
+				{
+				case Path::RUN_ONE:
+					machine.run_one();
+					break;
+				case Path::RUN:
+					machine.run(INSTRUCTIONS_PER_REFRESH);
+					break;
+				case Path::DEBUGGER:
+					debugger.run_one();
+					break;
+				case Path::RUN_AHEAD:
+					machine.run(INSTRUCTIONS_PER_REFRESH);
+					run_ahead.update();
+					break;
+				}
+			});
+
+			report("instruction " + std::to_string(word), PATH_NAMES[static_cast<int>(path)], allocations);
+		}
+	}
+
+	for (int i = 1; i < argc; ++i)
+	{
+		ifstream rom{ argv[i], ios::binary };
+		if (!rom)
+		{
+			cerr << "Cannot open " << argv[i] << '\n';
+			return 1;
+		}
+		const auto program = read_program(rom);
+
+		constexpr size_t num_frames = SECONDS_PER_ROM * SCREEN_REFRESHES_PER_SECOND;
+		for (const auto path : PATHS)
+		{
+			set_up(path);
+			machine.write_program(program.data(), program.size());
+			warm_up(path);
+
+			const auto allocations = count_allocations([&]
+			{
+				switch (path)
+				{
+				case Path::RUN_ONE:
+					for (size_t n = 0; n < num_frames * INSTRUCTIONS_PER_REFRESH && machine.run_one(); ++n)
+					{
+					}
+					break;
+				case Path::RUN:
+					machine.run_frames(num_frames);
+					break;
+				case Path::DEBUGGER:
+					debugger.run_frames(num_frames);
+					break;
+				case Path::RUN_AHEAD:
+					for (size_t frame = 0; frame < num_frames; ++frame)
+					{
+						machine.run_frames(1);
+						run_ahead.update();
+					}
+					break;
+				}
+			});
+
+			report(argv[i], PATH_NAMES[static_cast<int>(path)], allocations);
+		}
+
+		Vector_environment environment{ program, NUM_ENVIRONMENT_MACHINES, NUM_ENVIRONMENT_THREADS };
+		const array<Key_mask, NUM_ENVIRONMENT_MACHINES> keys{ 0x0000, 0x0001, 0x0020, 0x8000 };
+
+		const auto allocations = count_allocations([&]
+		{
+			for (size_t frame = 0; frame < num_frames; ++frame)
+			{
+				environment.step(keys.data());
+			}
+		});
+
+		report(argv[i], VECTOR_ENVIRONMENT_PATH_NAME, allocations);
+	}
+
+	if (allocated)
+	{
+		return 1;
+	}
+
+	cout << "No allocations while executing\n";
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+
+#include "CHIP-8.hpp"
+#include "debugger.hpp"
+#include "translator.hpp"
+#include "compiled-program.hpp"
+#include "helpers.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+
+using std::cout;
+using std::cerr;
+using std::ifstream;
+using std::ofstream;
+using std::ios;
+using std::string;
+using std::stoul;
+using std::system;
+
+#ifndef CHIP8_INCLUDE_DIR
+#define CHIP8_INCLUDE_DIR "CHIP-8"
+#endif
+
+constexpr auto DEFAULT_COMPILER = "c++ -std=c++20 -O2 -shared -fPIC";
+
+bool verify(CHIP_8& interpreted, CHIP_8& compiled, size_t num_instructions);
+
+/**
+ * Translates a ROM to C++, compiles it into a shared library which can be
+ * loaded with Compiled_program, and optionally checks that the library behaves
+ * exactly like the interpreter.
+ */
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		cerr << "Usage: " << argv[0] << " rom library [--source file] [--compiler command]"
+			<< " [--include dir] [--verify instructions]\n";
+		return 1;
+	}
+
+	const string rom_path = argv[1];
+	const string library_path = argv[2];
+	string source_path = library_path + ".cpp";
+	string compiler = DEFAULT_COMPILER;
+	string include_dir = CHIP8_INCLUDE_DIR;
+	size_t num_instructions_to_verify = 0;
+
+	for (int i = 3; i + 1 < argc; i += 2)
+	{
+		const string option = argv[i];
+		if (option == "--source")
+		{
+			source_path = argv[i + 1];
+		}
+		else if (option == "--compiler")
+		{
+			compiler = argv[i + 1];
+		}
+		else if (option == "--include")
+		{
+			include_dir = argv[i + 1];
+		}
+		else if (option == "--verify")
+		{
+			num_instructions_to_verify = stoul(argv[i + 1]);
+		}
+		else
+		{
+			cerr << "Unknown option: " << option << '\n';
+			return 1;
+		}
+	}
+
+	ifstream rom{ rom_path, ios::binary };
+	if (!rom)
+	{
+		cerr << "Cannot open " << rom_path << '\n';
+		return 1;
+	}
+
+	const auto bytes = read_program(rom);
+
+	CHIP_8 interpreted;
+	interpreted.load_program_from_bytes(bytes);
+
+	ofstream{ source_path } << Translator{ interpreted }.translate();
+
+	const auto command = compiler + " -I\"" + include_dir + "\" -o \"" + library_path + "\" \"" + source_path + "\"";
+	if (system(command.c_str()) != 0)
+	{
+		cerr << "Compilation failed: " << command << '\n';
+		return 1;
+	}
+
+	if (num_instructions_to_verify == 0)
+	{
+		return 0;
+	}
+
+	CHIP_8 compiled;
+	compiled.load_program_from_bytes(bytes);
+
+	const Compiled_program program{ library_path };
+	compiled.set_compiled_program(&program);
+
+	return verify(interpreted, compiled, num_instructions_to_verify) ? 0 : 1;
+}
+
+/**
+ * Run both machines in lockstep and compare their states after every
+ * instruction.
+ */
+bool verify(CHIP_8& interpreted, CHIP_8& compiled, size_t num_instructions)
+{
+	Debugger interpreted_view{ interpreted };
+	Debugger compiled_view{ compiled };
+
+	for (size_t i = 0; i < num_instructions; ++i)
+	{
+		// Both machines start with the same seed, so Cxkk agrees too.
+		const auto interpreted_running = interpreted.run_one();
+		const auto compiled_running = compiled.run_one();
+
+		// Everything, down to the stack, timers and cycle count.
+		const bool same = interpreted_running == compiled_running
+			&& interpreted_view.get_state() == compiled_view.get_state();
+
+		if (!same)
+		{
+			cerr << "Mismatch after instruction " << i << ", pc " << std::hex
+				<< interpreted_view.get_pc() << " vs " << compiled_view.get_pc() << '\n';
+			return false;
+		}
+
+		if (!interpreted_running)
+		{
+			break;
+		}
+	}
+
+	cout << "Translated program matches the interpreter\n";
+	return true;
+}
@@ -0,0 +1,417 @@
+#include <iostream>
+#include <iomanip>
+#include <array>
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+
+#include "CHIP-8.hpp"
+#include "debugger.hpp"
+#include "helpers.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+#include "render.hpp"
+#include "vector-environment.hpp"
+
+using std::cout;
+using std::cerr;
+using std::array;
+using std::vector;
+using std::string;
+using std::function;
+using std::stoul;
+using std::stod;
+using std::fixed;
+using std::setprecision;
+using std::chrono::steady_clock;
+using std::chrono::duration;
+
+/**
+ * Measures the costs which matter most for running the core, on synthetic
+ * ROMs, and prints them as JSON so that results can be compared across
+ * commits.
+ *
+ * Every benchmark is first run with growing numbers of operations until one
+ * run takes `--min-time` seconds. That run is then repeated `--repeat` times,
+ * and the median is reported. The benchmarks, their order and the format of
+ * the output only change together with FORMAT_VERSION.
+ */
+
+constexpr auto FORMAT_VERSION = 3; /* 1 had no render benchmarks, 2 no vector_environment */
+constexpr auto LOOP_LENGTH = 64 /* instructions, including the jump back */;
+
+/**
+ * Runs about `n` operations and returns how many it actually ran.
+ */
+using Benchmark_function = function<std::uint64_t(std::uint64_t n)>;
+
+struct Benchmark
+{
+	string name;
+	string unit;
+	Benchmark_function run;
+};
+
+struct Measurement
+{
+	std::uint64_t ops;
+	double seconds;
+};
+
+// Results are added up here so that the compiler can't leave out the work.
+static volatile std::uint64_t sink;
+
+vector<Benchmark> get_benchmarks(CHIP_8& machine);
+Measurement measure(const Benchmark_function& f, double min_time, size_t repeat);
+vector<byte> make_loop(const vector<instruction_t>& setup, const vector<instruction_t>& body);
+Benchmark make_opcode_benchmark(CHIP_8& machine, const string& family, const vector<byte>& program);
+array<byte, MAX_NUM_INSTRUCTIONS * INSTRUCTION_SIZE> make_random_bytes();
+array<Frame_buffer, 16> make_screens();
+
+int main(int argc, char* argv[])
+{
+	double min_time = 0.1;
+	size_t repeat = 5;
+	for (int i = 1; i < argc; i += 2)
+	{
+		const string option = argv[i];
+		if (i + 1 >= argc || (option != "--min-time" && option != "--repeat"))
+		{
+			cerr << "Usage: " << argv[0] << " [--min-time seconds] [--repeat times]\n";
+			return 1;
+		}
+
+		if (option == "--min-time")
+		{
+			min_time = stod(argv[i + 1]);
+		}
+		else
+		{
+			repeat = std::max<size_t>(stoul(argv[i + 1]), 1);
+		}
+	}
+
+	static CHIP_8 machine;
+	const auto benchmarks = get_benchmarks(machine);
+
+	cout << "{\n"
+		<< "  \"format\": " << FORMAT_VERSION << ",\n"
+		<< "  \"min_time\": " << fixed << setprecision(3) << min_time << ",\n"
+		<< "  \"repeat\": " << repeat << ",\n"
+		<< "  \"benchmarks\": [\n";
+
+	for (size_t i = 0; i < benchmarks.size(); ++i)
+	{
+		const auto& benchmark = benchmarks[i];
+		const auto m = measure(benchmark.run, min_time, repeat);
+		const auto ns_per_op = m.seconds * 1e9 / m.ops;
+
+		cout << "    { \"name\": \"" << benchmark.name << "\", \"unit\": \"" << benchmark.unit << "\""
+			<< ", \"ops\": " << m.ops
+			<< ", \"ns_per_op\": " << setprecision(3) << ns_per_op
+			<< ", \"ops_per_second\": " << setprecision(0) << m.ops / m.seconds << " }"
+			<< (i + 1 < benchmarks.size() ? ",\n" : "\n");
+	}
+
+	cout << "  ]\n"
+		<< "}\n";
+}
+
+vector<Benchmark> get_benchmarks(CHIP_8& machine)
+{
+	vector<Benchmark> benchmarks;
+	const auto add_opcode = [&](const string& family, const vector<instruction_t>& setup, const vector<instruction_t>& body)
+	{
+		benchmarks.push_back(make_opcode_benchmark(machine, family, make_loop(setup, body)));
+	};
+
+	// Skips are set up so that they never skip, which keeps every loop going
+	// through all of its instructions.
+	add_opcode("00E0", {}, { 0x00E0 });
+	add_opcode("3XNN", {}, { 0x3001 });
+	add_opcode("4XNN", {}, { 0x4000 });
+	add_opcode("5XY0", { 0x6101 }, { 0x5010 });
+	add_opcode("6XNN", {}, { 0x6012, 0x6134, 0x6256, 0x6378 });
+	add_opcode("7XNN", {}, { 0x7001, 0x7102 });
+	add_opcode("8XYN", { 0x6105 }, { 0x8010, 0x8011, 0x8012, 0x8013, 0x8014, 0x8015, 0x8016, 0x8017, 0x801E });
+	add_opcode("9XY0", {}, { 0x9000 });
+	add_opcode("ANNN", {}, { 0xA300 });
+	add_opcode("CXNN", {}, { 0xC0FF });
+	add_opcode("DXYN", { 0xA050 }, { 0xD018 });
+	// No key is pressed, so only Ex9E never skips.
+	add_opcode("EX9E", { 0x6001 }, { 0xE09E, 0xE19E });
+	// I is set again before the writes, so they never reach the program.
+	add_opcode("FXNN", {}, { 0xA800, 0xF015, 0xF007, 0xF018, 0xF01E, 0xF029, 0xA800, 0xF333, 0xF355, 0xF365 });
+
+	// Jumps need a loop of their own: every jump goes to the next instruction,
+	// and a jump to itself would be skipped as idle.
+	{
+		vector<byte> jumps;
+		for (double_byte i = 0; i < LOOP_LENGTH; ++i)
+		{
+			const auto target = PROGRAM_DATA_START_LOCATION + (i + 1) % LOOP_LENGTH * INSTRUCTION_SIZE;
+			jumps.push_back(static_cast<byte>(0x10 | target >> BITS_PER_BYTE));
+			jumps.push_back(static_cast<byte>(target));
+		}
+		benchmarks.push_back(make_opcode_benchmark(machine, "1NNN", jumps));
+
+		for (size_t i = 0; i < jumps.size(); i += INSTRUCTION_SIZE)
+		{
+			jumps[i] = (jumps[i] & 0x0F) | 0xB0;
+		}
+		benchmarks.push_back(make_opcode_benchmark(machine, "BNNN", jumps));
+	}
+
+	// Every call goes to a subroutine which returns right away.
+	{
+		constexpr auto subroutine = 0x380;
+		auto calls = make_loop({}, { 0x2000 | subroutine });
+		calls.resize(subroutine - PROGRAM_DATA_START_LOCATION + INSTRUCTION_SIZE);
+		calls.back() = 0xEE;
+		benchmarks.push_back(make_opcode_benchmark(machine, "2NNN+00EE", calls));
+	}
+
+	benchmarks.push_back(Benchmark{ "draw/sprite_rows", "rows",
+		[](std::uint64_t n)
+		{
+			// Unlike opcode/DXYN, only the drawing itself, at every position.
+			Frame_buffer frame_buffer{};
+			std::uint64_t collisions = 0;
+			for (std::uint64_t i = 0; i < n; ++i)
+			{
+				collisions += frame_buffer.draw_sprite_row(i, i / FRAME_BUFFER_WIDTH, static_cast<byte>(i));
+			}
+			sink = sink + collisions + frame_buffer.rows[0];
+			return n;
+		} });
+
+	benchmarks.push_back(Benchmark{ "decode/get_current_instruction", "instructions",
+		[&machine, bytes = make_random_bytes()](std::uint64_t n)
+		{
+			machine.load_program_from_bytes(bytes);
+			// Only here to move pc, so it keeps the shortest history there is.
+			Debugger debugger{ machine, 1 };
+
+			std::uint64_t sum = 0;
+			for (std::uint64_t i = 0; i < n; ++i)
+			{
+				debugger.set_pc(static_cast<double_byte>(PROGRAM_DATA_START_LOCATION + i % MAX_NUM_INSTRUCTIONS * INSTRUCTION_SIZE));
+				const auto ins = machine.get_current_instruction();
+				sum += ins.category + ins.payload.NNN;
+			}
+			sink = sink + sum;
+			return n;
+		} });
+
+	benchmarks.push_back(Benchmark{ "debugger/run_one", "instructions",
+		[&machine, program = make_loop({ 0x6105 }, { 0x7001, 0x8014, 0xA300, 0xF01E })](std::uint64_t n)
+		{
+			machine.load_program_from_bytes({});
+			machine.write_program(program.data(), program.size());
+			static Debugger debugger{ machine };
+
+			for (std::uint64_t i = 0; i < n; ++i)
+			{
+				debugger.run_one();
+			}
+			return n;
+		} });
+
+	benchmarks.push_back(Benchmark{ "load_program_from_bytes", "loads",
+		[&machine, bytes = make_random_bytes()](std::uint64_t n)
+		{
+			for (std::uint64_t i = 0; i < n; ++i)
+			{
+				machine.load_program_from_bytes(bytes);
+			}
+			sink = sink + machine.get_pc();
+			return n;
+		} });
+
+	benchmarks.push_back(Benchmark{ "frame_buffer/compare", "comparisons",
+		[](std::uint64_t n)
+		{
+			// Equal frame buffers are compared all the way to the end. Going
+			// through several keeps the comparison from being hoisted out.
+			static array<Frame_buffer, 16> frames{};
+			frames.back().rows.back() = 1;
+
+			std::uint64_t equal = 0;
+			for (std::uint64_t i = 0; i < n; ++i)
+			{
+				equal += frames[i % frames.size()] == frames[(i + 1) % frames.size()];
+			}
+			sink = sink + equal;
+			return n;
+		} });
+
+	// At the scales the frontends draw at.
+	for (const size_t scale : { 1, 10 })
+	{
+		benchmarks.push_back(Benchmark{ "render/rgba_x" + std::to_string(scale), "frames",
+			[scale, frames = make_screens()](std::uint64_t n)
+			{
+				vector<byte> pixels(get_rgba_image_size(scale));
+				for (std::uint64_t i = 0; i < n; ++i)
+				{
+					render_rgba(frames[i % frames.size()], DEFAULT_PALETTE, scale, pixels.data());
+				}
+				sink = sink + pixels[0];
+				return n;
+			} });
+	}
+
+	benchmarks.push_back(Benchmark{ "render/mono", "frames",
+		[frames = make_screens()](std::uint64_t n)
+		{
+			array<byte, get_mono_image_size(1)> pixels;
+			for (std::uint64_t i = 0; i < n; ++i)
+			{
+				render_mono(frames[i % frames.size()], 1, pixels.data());
+			}
+			sink = sink + pixels[0];
+			return n;
+		} });
+
+	benchmarks.push_back(Benchmark{ "render/bytes", "frames",
+		[frames = make_screens()](std::uint64_t n)
+		{
+			array<byte, BYTE_IMAGE_SIZE> pixels;
+			for (std::uint64_t i = 0; i < n; ++i)
+			{
+				render_bytes(frames[i % frames.size()], pixels.data());
+			}
+			sink = sink + pixels[0];
+			return n;
+		} });
+
+	// Machines which draw all the time, stepped on every hardware thread.
+	benchmarks.push_back(Benchmark{ "vector_environment/step", "frames",
+		[](std::uint64_t n)
+		{
+			static constexpr size_t num_machines = 256;
+			static const auto environment = []
+			{
+				const auto loop = make_loop({ 0xA000 }, { 0xD015, 0x7001, 0x7102 });
+				array<byte, MAX_NUM_INSTRUCTIONS * INSTRUCTION_SIZE> program{};
+				std::copy(loop.begin(), loop.end(), program.begin());
+				return std::make_unique<Vector_environment>(program, num_machines);
+			}();
+			static const vector<Key_mask> keys(num_machines);
+
+			const auto num_steps = (n + num_machines - 1) / num_machines;
+			for (std::uint64_t i = 0; i < num_steps; ++i)
+			{
+				environment->step(keys.data());
+			}
+			sink = sink + environment->get_observations()[0];
+			return num_steps * num_machines;
+		} });
+
+	return benchmarks;
+}
+
+/**
+ * Returns the median of `repeat` runs, each of which takes `min_time` seconds
+ * or more.
+ */
+Measurement measure(const Benchmark_function& f, double min_time, size_t repeat)
+{
+	const auto time = [&](std::uint64_t n)
+	{
+		const auto start = steady_clock::now();
+		const auto ops = f(n);
+		const duration<double> elapsed = steady_clock::now() - start;
+		return Measurement{ ops, elapsed.count() };
+	};
+
+	std::uint64_t n = 1;
+	for (auto m = time(n); m.seconds < min_time; m = time(n))
+	{
+		n *= m.seconds > 0 ? std::clamp(min_time / m.seconds * 1.2, 2.0, 100.0) : 100.0;
+	}
+
+	vector<Measurement> runs;
+	for (size_t i = 0; i < repeat; ++i)
+	{
+		runs.push_back(time(n));
+	}
+
+	const auto by_time_per_op = [](const Measurement& a, const Measurement& b)
+	{
+		return a.seconds / a.ops < b.seconds / b.ops;
+	};
+	std::nth_element(runs.begin(), runs.begin() + runs.size() / 2, runs.end(), by_time_per_op);
+	return runs[runs.size() / 2];
+}
+
+/**
+ * A program which runs `setup` once, followed by `body` over and over, as many
+ * times as fit in a loop of LOOP_LENGTH instructions.
+ */
+vector<byte> make_loop(const vector<instruction_t>& setup, const vector<instruction_t>& body)
+{
+	vector<instruction_t> instructions = setup;
+	const auto loop_start = PROGRAM_DATA_START_LOCATION + setup.size() * INSTRUCTION_SIZE;
+	for (size_t i = 0; i < (LOOP_LENGTH - 1) / body.size(); ++i)
+	{
+		instructions.insert(instructions.end(), body.begin(), body.end());
+	}
+	instructions.push_back(static_cast<instruction_t>(0x1000 | loop_start));
+
+	vector<byte> program;
+	for (const auto ins : instructions)
+	{
+		program.push_back(static_cast<byte>(ins >> BITS_PER_BYTE));
+		program.push_back(static_cast<byte>(ins));
+	}
+
+	return program;
+}
+
+/**
+ * Runs `program` through CHIP_8::run, which is what hosts do, so fused and
+ * skipped idioms count.
+ */
+Benchmark make_opcode_benchmark(CHIP_8& machine, const string& family, const vector<byte>& program)
+{
+	return Benchmark{ "opcode/" + family, "instructions",
+		[&machine, program](std::uint64_t n)
+		{
+			machine.load_program_from_bytes({});
+			machine.write_program(program.data(), program.size());
+			return machine.run(n).instructions_executed;
+		} };
+}
+
+array<byte, MAX_NUM_INSTRUCTIONS * INSTRUCTION_SIZE> make_random_bytes()
+{
+	array<byte, MAX_NUM_INSTRUCTIONS * INSTRUCTION_SIZE> bytes;
+
+	std::uint32_t state = DEFAULT_RANDOM_SEED;
+	for (auto& b : bytes)
+	{
+		b = random_byte(state);
+	}
+
+	return bytes;
+}
+
+/**
+ * Screens with a different pattern of pixels each, so that rendering them in
+ * turn can't be hoisted out of a loop.
+ */
+array<Frame_buffer, 16> make_screens()
+{
+	array<Frame_buffer, 16> screens;
+	for (size_t i = 0; i < screens.size(); ++i)
+	{
+		screens[i].rows.fill(0x0123456789ABCDEF * (i + 1));
+	}
+
+	return screens;
+}
\ No newline at end of file
@@ -0,0 +1,400 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <cstdint>
+
+#include "CHIP-8.hpp"
+#include "movie.hpp"
+#include "helpers.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+#include "render.hpp"
+
+using std::cout;
+using std::cerr;
+using std::ifstream;
+using std::ofstream;
+using std::ostringstream;
+using std::vector;
+using std::deque;
+using std::string;
+using std::unique_ptr;
+using std::make_unique;
+using std::exception;
+using std::stoul;
+using std::ios;
+using std::lock_guard;
+using std::unique_lock;
+namespace fs = std::filesystem;
+
+/**
+ * Runs a ROM without a window, optionally with a movie as input, and writes
+ * the frames it produces:
+ *
+ * - y4m: a single uncompressed video at SCREEN_REFRESHES_PER_SECOND with one
+ *   frame per refresh, which ffmpeg and most players read directly.
+ * - pbm, png: one image per changed frame in the output directory, named
+ *   after the refresh it was produced in.
+ *
+ * Frames are encoded and written on a separate thread, so slow disks never hold
+ * up the emulation.
+ */
+
+enum class Format
+{
+	Y4M, PBM, PNG
+};
+
+/**
+ * Encodes and writes frames in the order they were pushed, on a thread of its
+ * own. Destroying the writer waits for all pushed frames to be written.
+ */
+class Frame_writer
+{
+public:
+	Frame_writer(Format format, const fs::path& output, size_t scale);
+	~Frame_writer();
+
+	Frame_writer(const Frame_writer&) = delete;
+	Frame_writer& operator=(const Frame_writer&) = delete;
+
+	void push(size_t frame_number, const Frame_buffer& frame_buffer);
+private:
+	struct Frame
+	{
+		size_t number;
+		Frame_buffer frame_buffer;
+	};
+
+	void run();
+	void write(const Frame& frame);
+
+	vector<byte> scale_to_gray(const Frame_buffer& frame_buffer) const;
+	string encode_pbm(const Frame_buffer& frame_buffer) const;
+	string encode_png(const Frame_buffer& frame_buffer) const;
+
+	Format format;
+	fs::path output;
+	size_t scale;
+	size_t width;
+	size_t height;
+
+	ofstream video;
+
+	std::mutex mutex;
+	std::condition_variable frames_available;
+	deque<Frame> frames;
+	bool done;
+
+	std::thread thread;
+};
+
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		cerr << "Usage: " << argv[0] << " rom output [--format y4m|pbm|png] [--scale factor]"
+			<< " [--frames count] [--movie file]\n";
+		return 1;
+	}
+
+	auto format = Format::Y4M;
+	size_t scale = 1;
+	size_t num_frames = 10 * SCREEN_REFRESHES_PER_SECOND;
+	string movie_path;
+
+	for (int i = 3; i + 1 < argc; i += 2)
+	{
+		const string option = argv[i];
+		const string value = argv[i + 1];
+		if (option == "--format" && (value == "y4m" || value == "pbm" || value == "png"))
+		{
+			format = value == "y4m" ? Format::Y4M : value == "pbm" ? Format::PBM : Format::PNG;
+		}
+		else if (option == "--scale" && stoul(value) > 0)
+		{
+			scale = stoul(value);
+		}
+		else if (option == "--frames")
+		{
+			num_frames = stoul(value);
+		}
+		else if (option == "--movie")
+		{
+			movie_path = value;
+		}
+		else
+		{
+			cerr << "Invalid option: " << option << ' ' << value << '\n';
+			return 1;
+		}
+	}
+
+	ifstream rom{ argv[1], ios::binary };
+	if (!rom)
+	{
+		cerr << "Cannot open " << argv[1] << '\n';
+		return 1;
+	}
+
+	CHIP_8 machine;
+	machine.load_program_from_bytes(read_program(rom));
+
+	unique_ptr<Movie_player> player;
+	if (!movie_path.empty())
+	{
+		ifstream movie_file{ movie_path, ios::binary };
+		try
+		{
+			player = make_unique<Movie_player>(machine, load_movie(movie_file));
+		}
+		catch (const exception& e)
+		{
+			cerr << movie_path << ": " << e.what() << '\n';
+			return 1;
+		}
+	}
+
+	size_t num_written = 0;
+	{
+		Frame_writer writer{ format, argv[2], scale };
+
+		std::uint64_t previous_hash = 0;
+		for (size_t frame = 0; frame < num_frames; ++frame)
+		{
+			const auto result = player ? player->run_frames(1) : machine.run_frames(1);
+
+			const auto hash = hash_frame_buffer(machine.get_frame_buffer());
+			if (format == Format::Y4M || frame == 0 || hash != previous_hash)
+			{
+				writer.push(frame, machine.get_frame_buffer());
+				++num_written;
+			}
+			previous_hash = hash;
+
+			const auto is_done = player ? player->is_finished() : false;
+			if (is_done || result.status == Run_status::FINISHED || result.status == Run_status::FAULTED)
+			{
+				break;
+			}
+		}
+	}
+
+	cout << "Wrote " << num_written << " frames\n";
+}
+
+Frame_writer::Frame_writer(Format format, const fs::path& output, size_t scale)
+	: format{ format }, output{ output }, scale{ scale },
+	width{ FRAME_BUFFER_WIDTH * scale }, height{ FRAME_BUFFER_HEIGHT * scale }, done{ false }
+{
+	if (format == Format::Y4M)
+	{
+		video.open(output, ios::binary);
+		video << "YUV4MPEG2 W" << width << " H" << height << " F" << SCREEN_REFRESHES_PER_SECOND
+			<< ":1 Ip A1:1 C444\n";
+	}
+	else
+	{
+		fs::create_directories(output);
+	}
+
+	thread = std::thread{ &Frame_writer::run, this };
+}
+
+Frame_writer::~Frame_writer()
+{
+	{
+		lock_guard<std::mutex> lock{ mutex };
+		done = true;
+	}
+	frames_available.notify_one();
+
+	thread.join();
+}
+
+void Frame_writer::push(size_t frame_number, const Frame_buffer& frame_buffer)
+{
+	{
+		lock_guard<std::mutex> lock{ mutex };
+		frames.push_back(Frame{ frame_number, frame_buffer });
+	}
+	frames_available.notify_one();
+}
+
+void Frame_writer::run()
+{
+	for (;;)
+	{
+		unique_lock<std::mutex> lock{ mutex };
+		frames_available.wait(lock, [this] { return done || !frames.empty(); });
+		if (frames.empty())
+		{
+			return;
+		}
+
+		const auto frame = frames.front();
+		frames.pop_front();
+		lock.unlock();
+
+		write(frame);
+	}
+}
+
+void Frame_writer::write(const Frame& frame)
+{
+	if (format == Format::Y4M)
+	{
+		// Luma only changes; both chroma planes stay neutral.
+		const auto luma = scale_to_gray(frame.frame_buffer);
+		const string chroma(2 * luma.size(), static_cast<char>(128));
+
+		video << "FRAME\n";
+		video.write(reinterpret_cast<const char*>(luma.data()), luma.size());
+		video << chroma;
+		return;
+	}
+
+	ostringstream name;
+	name << std::setw(8) << std::setfill('0') << frame.number << (format == Format::PBM ? ".pbm" : ".png");
+
+	ofstream file{ output / name.str(), ios::binary };
+	file << (format == Format::PBM ? encode_pbm(frame.frame_buffer) : encode_png(frame.frame_buffer));
+}
+
+/**
+ * One byte per pixel, black for pixels which are on, like the frontends draw
+ * them.
+ */
+vector<byte> Frame_writer::scale_to_gray(const Frame_buffer& frame_buffer) const
+{
+	vector<byte> pixels(width * height);
+	for (size_t y = 0; y < height; ++y)
+	{
+		for (size_t x = 0; x < width; ++x)
+		{
+			pixels[y * width + x] = frame_buffer.get_pixel(x / scale, y / scale) ? 0 : 255;
+		}
+	}
+
+	return pixels;
+}
+
+/**
+ * Rows of pixels packed into bytes, most significant bit first, the way both
+ * PBM and 1-bit PNG images store them. Pixels which are on are set.
+ */
+static string render_lines(const Frame_buffer& frame_buffer, size_t scale)
+{
+	string lines(get_mono_image_size(scale), '\0');
+	render_mono(frame_buffer, scale, reinterpret_cast<byte*>(lines.data()));
+	return lines;
+}
+
+string Frame_writer::encode_pbm(const Frame_buffer& frame_buffer) const
+{
+	return "P4\n" + std::to_string(width) + " " + std::to_string(height) + "\n" + render_lines(frame_buffer, scale);
+}
+
+static std::uint32_t crc32(const string& data, size_t start)
+{
+	std::uint32_t crc = 0xFFFFFFFF;
+	for (size_t i = start; i < data.size(); ++i)
+	{
+		crc ^= static_cast<byte>(data[i]);
+		for (int bit = 0; bit < 8; ++bit)
+		{
+			crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+		}
+	}
+
+	return ~crc;
+}
+
+static void append_big_endian(string& data, std::uint32_t value)
+{
+	for (int shift = 24; shift >= 0; shift -= 8)
+	{
+		data += static_cast<char>(value >> shift);
+	}
+}
+
+static void append_chunk(string& png, const char* type, const string& contents)
+{
+	append_big_endian(png, static_cast<std::uint32_t>(contents.size()));
+
+	const auto chunk_start = png.size();
+	png += type;
+	png += contents;
+	append_big_endian(png, crc32(png, chunk_start));
+}
+
+/**
+ * A 1-bit grayscale PNG. The image data is wrapped in stored (uncompressed)
+ * deflate blocks, which keeps the encoder tiny and fast; the images are small
+ * anyway.
+ */
+string Frame_writer::encode_png(const Frame_buffer& frame_buffer) const
+{
+	// In grayscale, set bits are white, so pixels which are on are cleared.
+	const auto lines = render_lines(frame_buffer, scale);
+	const auto line_size = get_mono_bytes_per_line(scale);
+
+	string raw;
+	for (size_t start = 0; start < lines.size(); start += line_size)
+	{
+		raw += '\0'; // no filter
+		for (size_t i = start; i < start + line_size; ++i)
+		{
+			raw += static_cast<char>(~lines[i]);
+		}
+	}
+
+	constexpr size_t MAX_STORED_BLOCK_SIZE = 65535;
+
+	string zlib = "\x78\x01";
+	for (size_t start = 0; start < raw.size() || start == 0; start += MAX_STORED_BLOCK_SIZE)
+	{
+		const auto size = std::min(MAX_STORED_BLOCK_SIZE, raw.size() - start);
+		const bool is_last = start + size == raw.size();
+
+		zlib += static_cast<char>(is_last ? 1 : 0);
+		zlib += static_cast<char>(size & 0xFF);
+		zlib += static_cast<char>(size >> 8);
+		zlib += static_cast<char>(~size & 0xFF);
+		zlib += static_cast<char>((~size >> 8) & 0xFF);
+		zlib.append(raw, start, size);
+	}
+
+	std::uint32_t a = 1, b = 0;
+	for (const auto c : raw)
+	{
+		a = (a + static_cast<byte>(c)) % 65521;
+		b = (b + a) % 65521;
+	}
+	append_big_endian(zlib, b << 16 | a);
+
+	string header;
+	append_big_endian(header, static_cast<std::uint32_t>(width));
+	append_big_endian(header, static_cast<std::uint32_t>(height));
+	header += '\x01'; // bit depth
+	header += '\x00'; // grayscale
+	header += string(3, '\0'); // compression, filter, interlace
+
+	string png = "\x89PNG\r\n\x1a\n";
+	append_chunk(png, "IHDR", header);
+	append_chunk(png, "IDAT", zlib);
+	append_chunk(png, "IEND", "");
+
+	return png;
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <exception>
+
+#include "frame-publisher.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+
+using std::cout;
+using std::cerr;
+using std::hex;
+using std::dec;
+using std::setw;
+using std::setfill;
+using std::string;
+using std::exception;
+using std::chrono::nanoseconds;
+
+void print_frame(const Published_frame& frame);
+
+/**
+ * Shows the frames a Frame_publisher publishes, e.g. from the SFML frontend
+ * started with `--publish name`. Reading never slows the publisher down.
+ */
+int main(int argc, char* argv[])
+{
+	if (argc != 2 && !(argc == 3 && string{ argv[2] } == "--follow"))
+	{
+		cerr << "Usage: " << argv[0] << " name [--follow]\n";
+		return 1;
+	}
+
+	const auto follow = argc == 3;
+
+	try
+	{
+		const Frame_reader reader{ argv[1] };
+
+		Published_frame frame{};
+		auto last_frame_number = ~std::uint64_t{ 0 };
+		do
+		{
+			if (reader.read_latest(frame) && frame.frame_number != last_frame_number)
+			{
+				if (follow)
+				{
+					// Draw over the previous frame.
+					cout << "\x1b[H\x1b[2J";
+				}
+				print_frame(frame);
+				last_frame_number = frame.frame_number;
+			}
+			else if (!follow)
+			{
+				cerr << "Nothing was published yet\n";
+				return 1;
+			}
+
+			std::this_thread::sleep_for(nanoseconds{ NANOSECONDS_PER_REFRESH });
+		} while (follow);
+	}
+	catch (const exception& e)
+	{
+		cerr << e.what() << '\n';
+		return 1;
+	}
+}
+
+void print_frame(const Published_frame& frame)
+{
+	cout << "frame " << frame.frame_number << ", cycle " << frame.cycles << hex << setfill('0')
+		<< "\npc " << setw(3) << frame.pc << "  I " << setw(3) << frame.index_register
+		<< "  sp " << setw(2) << int{ frame.stack_pointer }
+		<< "  dt " << setw(2) << int{ frame.delay_timer } << "  st " << setw(2) << int{ frame.sound_timer };
+	if (frame.fault_code != Fault_code::NONE)
+	{
+		cout << "  faulted";
+	}
+	cout << '\n';
+
+	for (size_t i = 0; i < frame.registers.size(); ++i)
+	{
+		cout << 'V' << i << ' ' << setw(2) << int{ frame.registers[i] } << (i + 1 < frame.registers.size() ? " " : "\n");
+	}
+	cout << dec << setfill(' ');
+
+	for (size_t y = 0; y < FRAME_BUFFER_HEIGHT; ++y)
+	{
+		string line;
+		for (size_t x = 0; x < FRAME_BUFFER_WIDTH; ++x)
+		{
+			line += frame.frame_buffer.get_pixel(x, y) ? '#' : '.';
+		}
+		cout << line << '\n';
+	}
+	cout.flush();
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include <cstddef>
+#include <cstdint>
+#include <array>
+
+#include "CHIP-8.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+
+/**
+ * libFuzzer target which treats its input as a ROM.
+ *
+ * Every input starts from a snapshot of a freshly reset machine. Restoring it
+ * only copies back the memory pages the previous input wrote, which is what
+ * keeps the harness fast. Coverage of executed instructions and of edges
+ * between them is reported to libFuzzer through extra counters.
+ *
+ * Build with `-fsanitize=fuzzer`. Without libFuzzer, define
+ * CHIP8_FUZZ_STANDALONE to get a driver which runs the files given on the
+ * command line, e.g. to reproduce a crash.
+ */
+
+constexpr auto CYCLE_BUDGET = 4096 /* instructions per input */;
+constexpr auto EDGE_MAP_SIZE = 1 << 16;
+
+#if defined(__linux__) && !defined(CHIP8_FUZZ_STANDALONE)
+#define CHIP8_EXTRA_COUNTERS __attribute__((section("__libfuzzer_extra_counters")))
+#else
+#define CHIP8_EXTRA_COUNTERS
+#endif
+
+CHIP8_EXTRA_COUNTERS static std::uint8_t pc_counters[MEMORY_SIZE];
+CHIP8_EXTRA_COUNTERS static std::uint8_t edge_counters[EDGE_MAP_SIZE];
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size)
+{
+	static CHIP_8 machine;
+	static const auto clean_state = machine.take_snapshot();
+
+	machine.restore_snapshot(clean_state);
+	// Restoring the snapshot also resets the generator behind Cxkk, so every
+	// run of an input behaves the same.
+	machine.write_program(data, size);
+
+	auto previous_pc = machine.get_pc();
+	for (size_t i = 0; i < CYCLE_BUDGET; ++i)
+	{
+		const auto can_run_more = machine.run_one();
+		const auto pc = machine.get_pc();
+
+		++pc_counters[pc % MEMORY_SIZE];
+		++edge_counters[((previous_pc << 4) ^ pc) % EDGE_MAP_SIZE];
+		previous_pc = pc;
+
+		// Nobody presses keys during a run, so a wait for one ends it.
+		if (!can_run_more || machine.is_waiting_for_key())
+		{
+			break;
+		}
+	}
+
+	return 0;
+}
+
+#ifdef CHIP8_FUZZ_STANDALONE
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <chrono>
+
+int main(int argc, char* argv[])
+{
+	using std::chrono::steady_clock;
+	using std::chrono::duration;
+
+	constexpr auto RUNS_PER_FILE = 10000;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::ifstream input{ argv[i], std::ios::binary };
+		const std::vector<std::uint8_t> bytes{ std::istreambuf_iterator<char>{ input }, {} };
+
+		const auto start = steady_clock::now();
+		for (int run = 0; run < RUNS_PER_FILE; ++run)
+		{
+			LLVMFuzzerTestOneInput(bytes.data(), bytes.size());
+		}
+		const duration<double> elapsed = steady_clock::now() - start;
+
+		std::cout << argv[i] << ": " << RUNS_PER_FILE / elapsed.count() << " execs/s\n";
+	}
+}
+
+#endif
@@ -0,0 +1,114 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+
+#include "CHIP-8.hpp"
+#include "movie.hpp"
+#include "keyboard.hpp"
+#include "helpers.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+
+using std::cout;
+using std::cerr;
+using std::ifstream;
+using std::ios;
+using std::string;
+using std::stoul;
+using std::exception;
+using std::chrono::steady_clock;
+using std::chrono::duration;
+
+
+/**
+ * Replays a movie recorded by one of the frontends without a window or any
+ * throttling, and reports how fast the machine went. The same movie always
+ * executes the same instructions, which makes it a repeatable benchmark.
+ */
+int main(int argc, char* argv[])
+{
+	if (argc != 3 && argc != 5)
+	{
+		cerr << "Usage: " << argv[0] << " rom movie [--repeat times]\n";
+		return 1;
+	}
+
+	ifstream rom{ argv[1], ios::binary };
+	ifstream movie_file{ argv[2], ios::binary };
+	if (!rom || !movie_file)
+	{
+		cerr << "Cannot open " << (rom ? argv[2] : argv[1]) << '\n';
+		return 1;
+	}
+
+	size_t repeat = 1;
+	if (argc == 5)
+	{
+		if (string{ argv[3] } != "--repeat")
+		{
+			cerr << "Unknown option: " << argv[3] << '\n';
+			return 1;
+		}
+		repeat = stoul(argv[4]);
+	}
+
+	Movie movie;
+	try
+	{
+		movie = load_movie(movie_file);
+	}
+	catch (const exception& e)
+	{
+		cerr << e.what() << '\n';
+		return 1;
+	}
+
+	CHIP_8 machine;
+	machine.load_program_from_bytes(read_program(rom));
+	const auto start_state = machine.take_snapshot();
+
+	std::uint64_t instructions = 0;
+	auto result = Run_result{ 0, Run_status::RUNNING };
+	bool finished = false;
+
+	const auto start = steady_clock::now();
+	for (size_t i = 0; i < repeat; ++i)
+	{
+		// Keys aren't part of a snapshot.
+		machine.restore_snapshot(start_state);
+		for (auto k = Key::K0; k <= Key::KF; k = static_cast<Key>(static_cast<int>(k) + 1))
+		{
+			machine.keyboard.set_key_released(k);
+		}
+
+		Movie_player player{ machine, movie };
+		do
+		{
+			result = player.run(SIZE_MAX);
+			instructions += result.instructions_executed;
+		} while (!player.is_finished() && result.status == Run_status::RUNNING);
+
+		finished = player.is_finished();
+	}
+	const duration<double> elapsed = steady_clock::now() - start;
+
+	cout << instructions << " instructions in " << elapsed.count() << " s ("
+		<< instructions / elapsed.count() << " instructions/s)\n";
+
+	if (!finished)
+	{
+		const auto& fault = machine.get_fault();
+		cerr << "Replay stopped at cycle " << machine.get_cycle_count() << " of " << movie.end_cycle;
+		if (fault.code != Fault_code::NONE)
+		{
+			cerr << ", machine faulted at " << std::hex << fault.pc << " on instruction " << fault.instruction;
+		}
+		cerr << '\n';
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
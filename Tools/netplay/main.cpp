@@ -0,0 +1,234 @@
+#include <iostream>
+#include <fstream>
+#include <array>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+
+#include "CHIP-8.hpp"
+#include "rollback.hpp"
+#include "rollback-transport.hpp"
+#include "helpers.hpp"
+#include "keyboard.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+
+using std::cout;
+using std::cerr;
+using std::ifstream;
+using std::array;
+using std::unique_ptr;
+using std::make_unique;
+using std::ios;
+using std::string;
+using std::stoul;
+using std::exception;
+using std::chrono::duration;
+
+// Every player has half of the keypad: player 0 keys 0-7, player 1 keys 8-F.
+constexpr auto KEYS_PER_PLAYER = 8;
+
+// On average, a player's keys change every this many frames.
+constexpr auto FRAMES_PER_KEY_CHANGE = 8;
+
+/**
+ * The keys a player holds in each frame: a random key of their half, or none,
+ * held for a random number of frames.
+ */
+class Input_script
+{
+public:
+	Input_script(size_t player, std::uint32_t seed)
+		: player{ player }, state{ seed }, keys{ 0 }
+	{
+	}
+
+	Key_mask next()
+	{
+		if (random_byte(state) % FRAMES_PER_KEY_CHANGE == 0)
+		{
+			const auto key = random_byte(state) % (KEYS_PER_PLAYER + 1);
+			keys = key == KEYS_PER_PLAYER ? 0 : static_cast<Key_mask>(1u << (player * KEYS_PER_PLAYER + key));
+		}
+		return keys;
+	}
+private:
+	size_t player;
+	std::uint32_t state;
+	Key_mask keys;
+};
+
+bool same_machines(const CHIP_8& a, const CHIP_8& b);
+void print_stats(size_t player, const Rollback_session& session);
+
+/**
+ * Plays a ROM as two players with Rollback_sessions in one process, over a
+ * Loopback_link with `--delay` frames of latency or over UDP on localhost,
+ * with random keys. Reports how often and how expensively each side rolled
+ * back, and fails unless both machines end up exactly like one which was run
+ * with all keys known in advance.
+ */
+int main(int argc, char* argv[])
+{
+	if (argc < 2 || argc % 2 != 0)
+	{
+		cerr << "Usage: " << argv[0] << " rom [--frames N] [--delay frames] [--udp port] [--seed N]\n";
+		return 1;
+	}
+
+	size_t num_frames = 60 * SCREEN_REFRESHES_PER_SECOND;
+	size_t delay = 3;
+	size_t udp_port = 0;
+	std::uint32_t seed = DEFAULT_RANDOM_SEED;
+
+	for (int i = 2; i + 1 < argc; i += 2)
+	{
+		const string option = argv[i];
+		if (option == "--frames")
+		{
+			num_frames = stoul(argv[i + 1]);
+		}
+		else if (option == "--delay")
+		{
+			delay = stoul(argv[i + 1]);
+		}
+		else if (option == "--udp")
+		{
+			udp_port = stoul(argv[i + 1]);
+		}
+		else if (option == "--seed")
+		{
+			seed = static_cast<std::uint32_t>(stoul(argv[i + 1]));
+		}
+		else
+		{
+			cerr << "Unknown option: " << option << '\n';
+			return 1;
+		}
+	}
+
+	ifstream rom{ argv[1], ios::binary };
+	if (!rom)
+	{
+		cerr << "Cannot open " << argv[1] << '\n';
+		return 1;
+	}
+
+	const auto program = read_program(rom);
+
+	// Machines are kept off the stack, like the sessions which hold states.
+	auto reference = make_unique<CHIP_8>();
+	array<unique_ptr<CHIP_8>, 2> machines{ make_unique<CHIP_8>(), make_unique<CHIP_8>() };
+	for (auto machine : { reference.get(), machines[0].get(), machines[1].get() })
+	{
+		machine->load_program_from_bytes(program);
+	}
+
+	unique_ptr<Loopback_link> link;
+	array<unique_ptr<Udp_transport>, 2> sockets;
+	array<Rollback_transport*, 2> transports;
+	try
+	{
+		if (udp_port != 0)
+		{
+			const auto port = static_cast<std::uint16_t>(udp_port);
+			sockets[0] = make_unique<Udp_transport>(port, "127.0.0.1", static_cast<std::uint16_t>(port + 1));
+			sockets[1] = make_unique<Udp_transport>(static_cast<std::uint16_t>(port + 1), "127.0.0.1", port);
+			transports = { sockets[0].get(), sockets[1].get() };
+		}
+		else
+		{
+			link = make_unique<Loopback_link>(delay);
+			transports = { &link->get_end(0), &link->get_end(1) };
+		}
+	}
+	catch (const exception& e)
+	{
+		cerr << e.what() << '\n';
+		return 1;
+	}
+
+	array<unique_ptr<Rollback_session>, 2> sessions{
+		make_unique<Rollback_session>(*machines[0], *transports[0]),
+		make_unique<Rollback_session>(*machines[1], *transports[1]),
+	};
+
+	// The reference runs with the keys of both players, as they are pressed.
+	array<Input_script, 2> scripts{ Input_script{ 0, seed }, Input_script{ 1, seed + 1 } };
+	array<Key_mask, 2> keys{ scripts[0].next(), scripts[1].next() };
+	for (size_t frame = 0; frame < num_frames; ++frame)
+	{
+		reference->keyboard.set_pressed_keys(keys[0] | keys[1]);
+		reference->run_frames(1);
+
+		// A side which stalls holds the same keys until it can go on.
+		for (size_t player = 0; player < 2; ++player)
+		{
+			auto& session = *sessions[player];
+			while (session.get_frame() == frame && !session.advance(keys[player]))
+			{
+				sessions[1 - player]->poll();
+			}
+			keys[player] = scripts[player].next();
+		}
+	}
+
+	// Let the last keys arrive, so that both sides correct their last frames.
+	for (size_t attempt = 0; attempt < 1000; ++attempt)
+	{
+		if (sessions[0]->get_confirmed_frame() == num_frames && sessions[1]->get_confirmed_frame() == num_frames)
+		{
+			break;
+		}
+		sessions[0]->poll();
+		sessions[1]->poll();
+	}
+
+	cout << num_frames << " frames over " << (udp_port != 0 ? "UDP" : "a loopback link with a delay of " + std::to_string(delay) + " frames") << '\n';
+	print_stats(0, *sessions[0]);
+	print_stats(1, *sessions[1]);
+
+	for (size_t player = 0; player < 2; ++player)
+	{
+		if (sessions[player]->get_confirmed_frame() != num_frames)
+		{
+			cerr << "Player " << player << " never received the last keys\n";
+			return 1;
+		}
+
+		if (!same_machines(*machines[player], *reference))
+		{
+			cerr << "Player " << player << "'s machine differs from the reference\n";
+			return 1;
+		}
+	}
+
+	cout << "Both machines match the reference\n";
+	return 0;
+}
+
+bool same_machines(const CHIP_8& a, const CHIP_8& b)
+{
+	return a.get_frame_buffer() == b.get_frame_buffer()
+		&& a.get_cycle_count() == b.get_cycle_count()
+		&& a.get_pc() == b.get_pc()
+		&& a.get_delay_timer() == b.get_delay_timer()
+		&& a.get_sound_timer() == b.get_sound_timer()
+		&& a.get_fault().code == b.get_fault().code;
+}
+
+void print_stats(size_t player, const Rollback_session& session)
+{
+	const auto& stats = session.get_stats();
+	const duration<double, std::milli> total = stats.resimulation_time;
+	const duration<double, std::micro> worst = stats.max_resimulation_time;
+	const auto average = stats.rollbacks != 0 ? duration<double, std::micro>{ stats.resimulation_time }.count() / stats.rollbacks : 0;
+
+	cout << "Player " << player << ": "
+		<< stats.rollbacks << " rollbacks, "
+		<< stats.frames_resimulated << " frames run again (at most " << stats.max_frames_resimulated << " at once), "
+		<< total.count() << " ms spent (" << average << " us on average, at most " << worst.count() << " us), "
+		<< stats.stalls << " stalls\n";
+}
\ No newline at end of file
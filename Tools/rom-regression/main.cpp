@@ -0,0 +1,351 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <array>
+#include <vector>
+#include <string>
+#include <memory>
+#include <filesystem>
+#include <exception>
+#include <cstdint>
+
+#include "CHIP-8.hpp"
+#include "movie.hpp"
+#include "helpers.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+
+using std::cout;
+using std::cerr;
+using std::ifstream;
+using std::ofstream;
+using std::istringstream;
+using std::ostringstream;
+using std::array;
+using std::vector;
+using std::string;
+using std::unique_ptr;
+using std::make_unique;
+using std::exception;
+using std::stoull;
+using std::ios;
+using std::istream;
+namespace fs = std::filesystem;
+
+/**
+ * Checks ROMs against checkpoints listed in a manifest:
+ *
+ *     # Paths are relative to the manifest.
+ *     rom pong.ch8 movie pong.c8mv
+ *     at 5400 screen 8c2f0a5e3d7b9a11 registers 00112233445566778899aabbccddeeff
+ *
+ * Every `at` line belongs to the `rom` line above it, and says that after that
+ * many instructions the screen hashes (see hash_frame_buffer) to `screen` and
+ * V0 to VF hold `registers`. Either part may be left out. Without a movie, the
+ * ROM runs without input.
+ *
+ * The expected screen of each checkpoint can be kept in
+ * `<manifest>.screens/<rom>[-<movie>]-<cycle>.txt`. When there is one, a screen
+ * mismatch is reported as a diff against it. Run with `--update` to rewrite
+ * the manifest and the screens with the actual results.
+ */
+
+constexpr auto PIXEL_ON = '#';
+constexpr auto PIXEL_OFF = '.';
+
+class Rom_run
+{
+public:
+	Rom_run(const fs::path& rom_path, const fs::path& movie_path);
+
+	void advance_to(std::uint64_t cycle);
+
+	CHIP_8 machine;
+private:
+	void restart();
+
+	array<byte, MAX_NUM_INSTRUCTIONS * INSTRUCTION_SIZE> program;
+	unique_ptr<Movie> movie;
+	unique_ptr<Movie_player> player;
+};
+
+string format_screen(const Frame_buffer& frame_buffer);
+string format_registers(const array<byte, NUM_REGISTERS>& registers);
+string format_hash(std::uint64_t hash);
+void print_screen_diff(const string& expected, const string& actual);
+
+int main(int argc, char* argv[])
+{
+	const bool update = argc == 3 && string{ argv[2] } == "--update";
+	if (argc != 2 && !update)
+	{
+		cerr << "Usage: " << argv[0] << " manifest [--update]\n";
+		return 1;
+	}
+
+	const fs::path manifest_path = argv[1];
+	const auto base_dir = manifest_path.parent_path();
+	const auto screens_dir = fs::path{ manifest_path.string() + ".screens" };
+
+	ifstream manifest{ manifest_path };
+	if (!manifest)
+	{
+		cerr << "Cannot open " << manifest_path.string() << '\n';
+		return 1;
+	}
+
+	unique_ptr<Rom_run> run;
+	string screen_name_prefix;
+	vector<string> updated_lines;
+	size_t num_checkpoints = 0;
+	size_t num_failed = 0;
+
+	string line;
+	for (size_t line_number = 1; getline(manifest, line); ++line_number)
+	{
+		istringstream tokens{ line };
+		string keyword;
+		tokens >> keyword;
+
+		const auto location = manifest_path.string() + ":" + std::to_string(line_number) + ": ";
+		if (keyword.empty() || keyword[0] == '#')
+		{
+			updated_lines.push_back(line);
+			continue;
+		}
+
+		try
+		{
+			if (keyword == "rom")
+			{
+				string rom, option, movie;
+				tokens >> rom >> option >> movie;
+				if (!option.empty() && option != "movie")
+				{
+					throw std::runtime_error("unknown option " + option);
+				}
+
+				run = make_unique<Rom_run>(base_dir / rom, movie.empty() ? fs::path{} : base_dir / movie);
+				screen_name_prefix = fs::path{ rom }.stem().string();
+				if (!movie.empty())
+				{
+					screen_name_prefix += "-" + fs::path{ movie }.stem().string();
+				}
+
+				updated_lines.push_back(line);
+				continue;
+			}
+
+			if (keyword != "at")
+			{
+				throw std::runtime_error("unknown keyword " + keyword);
+			}
+			if (!run)
+			{
+				throw std::runtime_error("checkpoint before any rom");
+			}
+
+			string cycle_text, expected_hash, expected_registers;
+			tokens >> cycle_text;
+			for (string part, value; tokens >> part >> value; )
+			{
+				(part == "screen" ? expected_hash : expected_registers) = value;
+			}
+
+			const auto cycle = stoull(cycle_text);
+			run->advance_to(cycle);
+			++num_checkpoints;
+
+			const auto actual_screen = format_screen(run->machine.get_frame_buffer());
+			const auto actual_hash = format_hash(hash_frame_buffer(run->machine.get_frame_buffer()));
+			const auto actual_registers = format_registers(run->machine.get_registers());
+			const auto screen_path = screens_dir / (screen_name_prefix + "-" + cycle_text + ".txt");
+
+			if (update)
+			{
+				updated_lines.push_back("at " + cycle_text + " screen " + actual_hash + " registers " + actual_registers);
+
+				fs::create_directories(screens_dir);
+				ofstream{ screen_path } << actual_screen;
+				continue;
+			}
+
+			updated_lines.push_back(line);
+
+			const bool screen_matches = expected_hash.empty() || expected_hash == actual_hash;
+			const bool registers_match = expected_registers.empty() || expected_registers == actual_registers;
+			if (screen_matches && registers_match)
+			{
+				continue;
+			}
+
+			++num_failed;
+			cout << location << "mismatch at cycle " << cycle;
+			if (run->machine.get_cycle_count() != cycle)
+			{
+				cout << " (machine stopped at cycle " << run->machine.get_cycle_count() << ")";
+			}
+			cout << '\n';
+
+			if (!registers_match)
+			{
+				cout << "  registers " << actual_registers << ", expected " << expected_registers << '\n';
+			}
+			if (!screen_matches)
+			{
+				cout << "  screen " << actual_hash << ", expected " << expected_hash << '\n';
+
+				ifstream golden{ screen_path };
+				if (golden)
+				{
+					ostringstream expected_screen;
+					expected_screen << golden.rdbuf();
+					print_screen_diff(expected_screen.str(), actual_screen);
+				}
+				else
+				{
+					cout << actual_screen;
+				}
+			}
+		}
+		catch (const exception& e)
+		{
+			cerr << location << e.what() << '\n';
+			return 1;
+		}
+	}
+
+	if (update)
+	{
+		manifest.close();
+
+		ofstream rewritten{ manifest_path };
+		for (const auto& l : updated_lines)
+		{
+			rewritten << l << '\n';
+		}
+
+		cout << "Updated " << num_checkpoints << " checkpoints\n";
+		return 0;
+	}
+
+	cout << num_checkpoints - num_failed << " of " << num_checkpoints << " checkpoints passed\n";
+	return num_failed == 0 ? 0 : 1;
+}
+
+Rom_run::Rom_run(const fs::path& rom_path, const fs::path& movie_path)
+	: program{}
+{
+	ifstream rom{ rom_path, ios::binary };
+	if (!rom)
+	{
+		throw std::runtime_error("cannot open " + rom_path.string());
+	}
+	program = read_program(rom);
+
+	if (!movie_path.empty())
+	{
+		ifstream movie_file{ movie_path, ios::binary };
+		if (!movie_file)
+		{
+			throw std::runtime_error("cannot open " + movie_path.string());
+		}
+		movie = make_unique<Movie>(load_movie(movie_file));
+	}
+
+	restart();
+}
+
+void Rom_run::restart()
+{
+	machine.load_program_from_bytes(program);
+	if (movie)
+	{
+		player = make_unique<Movie_player>(machine, *movie);
+	}
+}
+
+/**
+ * Runs the machine until it has executed `cycle` instructions, or until it
+ * can't run any further. Once the movie is over, the ROM carries on without
+ * new input.
+ */
+void Rom_run::advance_to(std::uint64_t cycle)
+{
+	if (cycle < machine.get_cycle_count())
+	{
+		restart();
+	}
+
+	while (machine.get_cycle_count() < cycle)
+	{
+		const auto budget = static_cast<size_t>(cycle - machine.get_cycle_count());
+		const auto result = player && !player->is_finished() ? player->run(budget) : machine.run(budget);
+		if (result.status == Run_status::FINISHED || result.status == Run_status::FAULTED)
+		{
+			break;
+		}
+	}
+}
+
+string format_screen(const Frame_buffer& frame_buffer)
+{
+	string screen;
+	for (size_t y = 0; y < FRAME_BUFFER_HEIGHT; ++y)
+	{
+		for (size_t x = 0; x < FRAME_BUFFER_WIDTH; ++x)
+		{
+			screen += frame_buffer.get_pixel(x, y) ? PIXEL_ON : PIXEL_OFF;
+		}
+		screen += '\n';
+	}
+
+	return screen;
+}
+
+string format_registers(const array<byte, NUM_REGISTERS>& registers)
+{
+	constexpr auto digits = "0123456789abcdef";
+
+	string text;
+	for (const auto r : registers)
+	{
+		text += digits[r >> 4];
+		text += digits[r & 0xF];
+	}
+
+	return text;
+}
+
+string format_hash(std::uint64_t hash)
+{
+	ostringstream text;
+	text << std::hex;
+	text.width(16);
+	text.fill('0');
+	text << hash;
+
+	return text.str();
+}
+
+/**
+ * Prints the expected and actual screens side by side, marking the rows which
+ * differ.
+ */
+void print_screen_diff(const string& expected, const string& actual)
+{
+	istringstream expected_rows{ expected };
+	istringstream actual_rows{ actual };
+
+	cout << "  " << string(FRAME_BUFFER_WIDTH - 8, ' ') << "expected  " << string(FRAME_BUFFER_WIDTH - 6, ' ') << "actual\n";
+	for (string e, a; getline(actual_rows, a); )
+	{
+		if (!getline(expected_rows, e))
+		{
+			e.clear();
+		}
+		e.resize(FRAME_BUFFER_WIDTH, ' ');
+
+		cout << (e == a ? "  " : "* ") << e << "  " << a << '\n';
+	}
+}
\ No newline at end of file
@@ -0,0 +1,436 @@
+#include <iostream>
+#include <fstream>
+#include <array>
+#include <memory>
+#include <string>
+#include <utility>
+#include <cstdint>
+
+#include "CHIP-8.hpp"
+#include "debugger.hpp"
+#include "helpers.hpp"
+#include "keyboard.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+
+using std::cout;
+using std::cerr;
+using std::ifstream;
+using std::ios;
+using std::array;
+using std::unique_ptr;
+using std::make_unique;
+using std::string;
+using std::stoul;
+
+using Program = array<byte, MAX_NUM_INSTRUCTIONS * INSTRUCTION_SIZE>;
+
+constexpr auto DEFAULT_NUM_PROGRAMS = 1000;
+constexpr auto PROGRAM_LENGTH = 128 /* instructions */;
+constexpr auto INSTRUCTIONS_PER_PROGRAM = 20000;
+constexpr auto MAX_CHUNK_SIZE = 600 /* instructions */;
+constexpr auto NUM_KEYS = static_cast<int>(Key::NONE);
+
+// Where programs store data, past their code.
+constexpr auto DATA_START = PROGRAM_DATA_START_LOCATION + PROGRAM_LENGTH * INSTRUCTION_SIZE;
+
+// On average, a snapshot is taken and a branch thrown away once every this
+// many chunks.
+constexpr auto CHUNKS_PER_SNAPSHOT = 8;
+
+Program make_program(std::uint32_t& state);
+bool check_program(const Program& program, std::uint32_t seed, const string& name);
+
+/**
+ * Checks that CHIP_8::run, with its fused idioms and skipped idle loops, ends
+ * up exactly where as many calls to CHIP_8::run_one do: same registers, index
+ * register, pc, memory, screen, cycles, timers and fault.
+ *
+ * Programs are made of random instructions and of the idioms the core speeds
+ * up, with jumps and calls within the program and stores which may land in
+ * its own code. Both machines are run in chunks of random size with the same
+ * random keys pressed in between. Every few chunks, the machine under test
+ * takes a snapshot, runs a branch which is thrown away and goes back to the
+ * snapshot, and a spare machine restores the snapshot over an earlier one;
+ * either of them carries on. ROMs given on the command line are run the same
+ * way. Exits with 1 at the first difference.
+ */
+int main(int argc, char* argv[])
+{
+	size_t num_programs = DEFAULT_NUM_PROGRAMS;
+	std::uint32_t seed = DEFAULT_RANDOM_SEED;
+	int num_roms = 0;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const string argument = argv[i];
+		if (argument == "--programs" && i + 1 < argc)
+		{
+			num_programs = stoul(argv[++i]);
+		}
+		else if (argument == "--seed" && i + 1 < argc)
+		{
+			seed = static_cast<std::uint32_t>(stoul(argv[++i]));
+		}
+		else if (argument.rfind("--", 0) == 0)
+		{
+			cerr << "Usage: " << argv[0] << " [rom...] [--programs N] [--seed N]\n";
+			return 1;
+		}
+		else
+		{
+			argv[++num_roms] = argv[i];
+		}
+	}
+
+	for (int i = 1; i <= num_roms; ++i)
+	{
+		ifstream rom{ argv[i], ios::binary };
+		if (!rom)
+		{
+			cerr << "Cannot open " << argv[i] << '\n';
+			return 1;
+		}
+
+		if (!check_program(read_program(rom), seed, argv[i]))
+		{
+			return 1;
+		}
+	}
+
+	auto state = seed;
+	for (size_t i = 0; i < num_programs; ++i)
+	{
+		if (!check_program(make_program(state), seed + static_cast<std::uint32_t>(i), "random program " + std::to_string(i)))
+		{
+			return 1;
+		}
+	}
+
+	cout << "run matches run_one on " << num_roms << " ROMs and " << num_programs << " random programs\n";
+	return 0;
+}
+
+double_byte random_double_byte(std::uint32_t& state)
+{
+	return concatenate_bytes(random_byte(state), random_byte(state));
+}
+
+/**
+ * Writes instructions one after the other from PROGRAM_DATA_START_LOCATION, and
+ * picks targets for jumps and stores within the program.
+ */
+class Program_writer
+{
+public:
+	explicit Program_writer(std::uint32_t& state)
+		: state{ state }, program{}, size{ 0 }
+	{
+	}
+
+	void write(double_byte ins)
+	{
+		if (size + INSTRUCTION_SIZE <= PROGRAM_LENGTH * INSTRUCTION_SIZE)
+		{
+			program[size] = static_cast<byte>(ins >> BITS_PER_BYTE);
+			program[size + 1] = static_cast<byte>(ins);
+			size += INSTRUCTION_SIZE;
+		}
+	}
+
+	double_byte get_address() const
+	{
+		return static_cast<double_byte>(PROGRAM_DATA_START_LOCATION + size);
+	}
+
+	double_byte random_address() const
+	{
+		return static_cast<double_byte>(PROGRAM_DATA_START_LOCATION
+			+ random_double_byte(state) % PROGRAM_LENGTH * INSTRUCTION_SIZE);
+	}
+
+	// The last instruction is left for write_last.
+	bool is_full() const
+	{
+		return size + INSTRUCTION_SIZE >= PROGRAM_LENGTH * INSTRUCTION_SIZE;
+	}
+
+	void write_last(double_byte ins)
+	{
+		size = (PROGRAM_LENGTH - 1) * INSTRUCTION_SIZE;
+		write(ins);
+	}
+
+	const Program& get_program() const
+	{
+		return program;
+	}
+private:
+	std::uint32_t& state;
+	Program program;
+	size_t size;
+};
+
+// Every instruction which can't fault whatever its operands, and the bits of
+// it which are operands.
+constexpr array<std::pair<double_byte, double_byte>, 27> INSTRUCTIONS{ {
+	{ 0x00E0, 0x0000 }, { 0x3000, 0x0FFF }, { 0x4000, 0x0FFF }, { 0x5000, 0x0FF0 }, { 0x6000, 0x0FFF },
+	{ 0x7000, 0x0FFF }, { 0x8000, 0x0FF0 }, { 0x8001, 0x0FF0 }, { 0x8002, 0x0FF0 }, { 0x8003, 0x0FF0 },
+	{ 0x8004, 0x0FF0 }, { 0x8005, 0x0FF0 }, { 0x8006, 0x0FF0 }, { 0x8007, 0x0FF0 }, { 0x800E, 0x0FF0 },
+	{ 0x9000, 0x0FF0 }, { 0xA000, 0x0FFF }, { 0xC000, 0x0FFF }, { 0xD000, 0x0FFF }, { 0xF007, 0x0F00 },
+	{ 0xF015, 0x0F00 }, { 0xF018, 0x0F00 }, { 0xF01E, 0x0F00 }, { 0xF029, 0x0F00 }, { 0xF033, 0x0F00 },
+	{ 0xF055, 0x0F00 }, { 0xF065, 0x0F00 },
+} };
+
+Program make_program(std::uint32_t& state)
+{
+	Program_writer writer{ state };
+	while (!writer.is_full())
+	{
+		const double_byte x = random_byte(state) % NUM_REGISTERS;
+		const double_byte y = random_byte(state) % NUM_REGISTERS;
+		const double_byte nn = random_byte(state);
+
+		switch (random_byte(state) % 10)
+		{
+		case 0:
+			// A run of 6xNN loads.
+			for (auto n = random_byte(state) % 4 + 2; n > 0; --n)
+			{
+				writer.write(0x6000 | (random_byte(state) % NUM_REGISTERS) << 8 | random_byte(state));
+			}
+			break;
+		case 1:
+			// Annn followed by Dxyn, drawing a font sprite or the program.
+			writer.write(0xA000 | (nn % 2 == 0 ? random_byte(state) % 80 : writer.random_address()));
+			writer.write(0xD000 | x << 8 | y << 4 | (random_byte(state) % 15 + 1));
+			break;
+		case 2:
+		{
+			// A loop counter.
+			writer.write(0x6000 | x << 8);
+			const auto start = writer.get_address();
+			writer.write(0x7001 | x << 8);
+			writer.write((nn % 2 == 0 ? 0x3000 : 0x4000) | x << 8 | (random_byte(state) % 32 + 1));
+			writer.write(0x1000 | start);
+			break;
+		}
+		case 3:
+			// Fx1E followed by Fy65.
+			writer.write(0xF01E | x << 8);
+			writer.write(0xF065 | y << 8);
+			break;
+		case 4:
+		{
+			// Waiting for the delay timer.
+			writer.write(0x6000 | x << 8 | (nn % 64));
+			writer.write(0xF015 | x << 8);
+			const auto start = writer.get_address();
+			writer.write(0xF007 | y << 8);
+			writer.write(0x3000 | y << 8);
+			writer.write(0x1000 | start);
+			break;
+		}
+		case 5:
+			// Jumps and calls within the program, now and then a jump to
+			// itself or a return.
+			switch (nn % 16)
+			{
+			case 0:
+				writer.write(0x1000 | writer.get_address());
+				break;
+			case 1:
+				writer.write(0x2000 | writer.random_address());
+				break;
+			case 2:
+				writer.write(0x00EE);
+				break;
+			case 3:
+				writer.write(0xB000 | writer.random_address());
+				break;
+			default:
+				writer.write(0x1000 | writer.random_address());
+				break;
+			}
+			break;
+		case 6:
+			// Stores, now and then over the program's own code.
+			writer.write(0xA000 | (nn % 4 == 0 ? writer.random_address() : DATA_START + nn));
+			writer.write(nn % 2 == 0 ? 0xF055 | x << 8 : 0xF033 | x << 8);
+			break;
+		case 7:
+			// Keys, which the check presses at random.
+			writer.write(0x6000 | x << 8 | (nn % NUM_KEYS));
+			writer.write((nn % 3 == 0 ? 0xF00A : nn % 3 == 1 ? 0xE09E : 0xE0A1) | x << 8);
+			break;
+		case 8:
+			if (nn % 2 == 0)
+			{
+				// Annn and a placeholder, which turns into Dxyn once the code
+				// after it has run, so the idiom only shows up from then on.
+				writer.write(0xA000 | nn % 80);
+				const auto placeholder = writer.get_address();
+				writer.write(0x8000);
+				writer.write(0x60D0 | x);
+				writer.write(0x6100 | y << 4 | (random_byte(state) % 15 + 1));
+				writer.write(0xA000 | placeholder);
+				writer.write(0xF155);
+				break;
+			}
+
+			// Anything at all, which mostly faults.
+			if (nn % 8 == 1)
+			{
+				writer.write(random_double_byte(state));
+				break;
+			}
+			[[fallthrough]];
+		default:
+		{
+			// Any other instruction, with random operands.
+			const auto& [ins, operands] = INSTRUCTIONS[random_byte(state) % INSTRUCTIONS.size()];
+			writer.write(ins | (random_double_byte(state) & operands));
+			break;
+		}
+		}
+	}
+
+	// Programs start over rather than run into empty memory.
+	writer.write_last(0x1000 | PROGRAM_DATA_START_LOCATION);
+	return writer.get_program();
+}
+
+/**
+ * Describes the first way in which the machines differ, or returns nullptr if
+ * they don't.
+ */
+const char* find_difference(CHIP_8& a, const Debugger& a_view, CHIP_8& b, const Debugger& b_view)
+{
+	if (a_view.get_registers() != b_view.get_registers())
+	{
+		return "registers";
+	}
+	if (a_view.get_index_register() != b_view.get_index_register())
+	{
+		return "index register";
+	}
+	if (a.get_pc() != b.get_pc())
+	{
+		return "pc";
+	}
+	if (a_view.get_memory() != b_view.get_memory())
+	{
+		return "memory";
+	}
+	if (a.get_frame_buffer() != b.get_frame_buffer())
+	{
+		return "screen";
+	}
+	if (a.get_cycle_count() != b.get_cycle_count())
+	{
+		return "cycles";
+	}
+	if (a.get_delay_timer() != b.get_delay_timer() || a.get_sound_timer() != b.get_sound_timer())
+	{
+		return "timers";
+	}
+	if (a.get_fault().code != b.get_fault().code || a.get_fault().pc != b.get_fault().pc
+		|| a.get_fault().instruction != b.get_fault().instruction)
+	{
+		return "fault";
+	}
+	if (a.is_waiting_for_key() != b.is_waiting_for_key())
+	{
+		return "waiting for a key";
+	}
+
+	return nullptr;
+}
+
+/**
+ * Runs `size` instructions through run_one, stopping like run does at the first
+ * one which can't run.
+ */
+void run_one_at_a_time(CHIP_8& machine, size_t size)
+{
+	for (size_t i = 0; i < size && machine.run_one(); ++i)
+	{
+	}
+}
+
+bool check_program(const Program& program, std::uint32_t seed, const string& name)
+{
+	// Machines are kept off the stack, like snapshots of them.
+	auto tested = make_unique<CHIP_8>();
+	auto reference = make_unique<CHIP_8>();
+	auto spare = make_unique<CHIP_8>();
+	for (auto machine : { tested.get(), reference.get(), spare.get() })
+	{
+		machine->load_program_from_bytes(program);
+		machine->seed_random(seed);
+	}
+
+	// Only the current state is looked at, so one step of history is enough.
+	auto tested_view = make_unique<const Debugger>(*tested, 1);
+	auto spare_view = make_unique<const Debugger>(*spare, 1);
+	const Debugger reference_view{ *reference, 1 };
+
+	auto state = seed;
+	size_t executed = 0;
+	for (size_t chunk = 0; executed < INSTRUCTIONS_PER_PROGRAM; ++chunk)
+	{
+		const Key_mask keys = random_byte(state) % 2 == 0 ? 0 : static_cast<Key_mask>(1u << (random_byte(state) % NUM_KEYS));
+		const size_t size = random_double_byte(state) % MAX_CHUNK_SIZE + 1;
+
+		if (random_byte(state) % CHUNKS_PER_SNAPSHOT == 0)
+		{
+			const auto snapshot = tested->take_snapshot();
+			tested->keyboard.set_pressed_keys(static_cast<Key_mask>(~keys));
+			tested->run(size);
+			tested->restore_snapshot(snapshot);
+			// Snapshots leave the keyboard out, and setting the keys back
+			// would press them again.
+			tested->keyboard = reference->keyboard;
+
+			// The spare was left at an earlier snapshot, so it has pages to
+			// put back, and idioms to forget.
+			spare->restore_snapshot(snapshot);
+			spare->keyboard = reference->keyboard;
+			if (const auto difference = find_difference(*spare, *spare_view, *tested, *tested_view))
+			{
+				cerr << name << ": restoring a snapshot into another machine gives a different "
+					<< difference << " in chunk " << chunk << '\n';
+				return false;
+			}
+
+			// Either machine may carry on, and the other is the spare.
+			if (random_byte(state) % 2 == 0)
+			{
+				std::swap(tested, spare);
+				std::swap(tested_view, spare_view);
+			}
+		}
+
+		tested->keyboard.set_pressed_keys(keys);
+		reference->keyboard.set_pressed_keys(keys);
+
+		const auto result = tested->run(size);
+		run_one_at_a_time(*reference, size);
+
+		if (const auto difference = find_difference(*tested, *tested_view, *reference, reference_view))
+		{
+			cerr << name << ": run and run_one give a different " << difference << " after chunk " << chunk
+				<< " of " << size << " instructions, pc " << std::hex << tested->get_pc() << " vs "
+				<< reference->get_pc() << std::dec << '\n';
+			return false;
+		}
+
+		if (result.status == Run_status::FINISHED || result.status == Run_status::FAULTED)
+		{
+			break;
+		}
+		executed += size;
+	}
+
+	return true;
+}
\ No newline at end of file
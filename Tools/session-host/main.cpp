@@ -0,0 +1,120 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+#include "CHIP-8.hpp"
+#include "session-host.hpp"
+#include "helpers.hpp"
+#include "data-types.hpp"
+#include "machine-specs.hpp"
+
+using std::cout;
+using std::cerr;
+using std::ifstream;
+using std::vector;
+using std::unique_ptr;
+using std::make_unique;
+using std::ios;
+using std::istream;
+using std::string;
+using std::stoul;
+using std::atomic;
+using std::chrono::nanoseconds;
+using std::chrono::seconds;
+using std::chrono::duration;
+
+/**
+ * Runs many copies of a ROM on a Session_host in real time and reports how
+ * many frames missed their deadline, to find out how many sessions a machine
+ * can host.
+ */
+int main(int argc, char* argv[])
+{
+	if (argc < 2 || argc % 2 != 0)
+	{
+		cerr << "Usage: " << argv[0] << " rom [--sessions N] [--workers N] [--seconds N]\n";
+		return 1;
+	}
+
+	size_t num_sessions = 1000;
+	size_t num_workers = std::thread::hardware_concurrency();
+	size_t num_seconds = 5;
+
+	for (int i = 2; i + 1 < argc; i += 2)
+	{
+		const string option = argv[i];
+		if (option == "--sessions")
+		{
+			num_sessions = stoul(argv[i + 1]);
+		}
+		else if (option == "--workers")
+		{
+			num_workers = stoul(argv[i + 1]);
+		}
+		else if (option == "--seconds")
+		{
+			num_seconds = stoul(argv[i + 1]);
+		}
+		else
+		{
+			cerr << "Unknown option: " << option << '\n';
+			return 1;
+		}
+	}
+
+	ifstream rom{ argv[1], ios::binary };
+	if (!rom)
+	{
+		cerr << "Cannot open " << argv[1] << '\n';
+		return 1;
+	}
+
+	const auto program = read_program(rom);
+
+	Session_host host{ num_workers };
+
+	atomic<std::int64_t> worst_lateness{ 0 };
+	host.on_deadline_missed([&worst_lateness](Session_id, nanoseconds lateness)
+	{
+		auto worst = worst_lateness.load();
+		while (lateness.count() > worst && !worst_lateness.compare_exchange_weak(worst, lateness.count()))
+		{
+		}
+	});
+
+	vector<unique_ptr<CHIP_8>> machines;
+	vector<Session_id> ids;
+	for (size_t i = 0; i < num_sessions; ++i)
+	{
+		machines.push_back(make_unique<CHIP_8>());
+		machines.back()->load_program_from_bytes(program);
+		ids.push_back(host.add_session(*machines.back()));
+	}
+
+	host.start();
+	std::this_thread::sleep_for(seconds{ num_seconds });
+	host.stop();
+
+	std::uint64_t frames = 0;
+	std::uint64_t deadlines_missed = 0;
+	std::uint64_t frames_skipped = 0;
+	for (const auto id : ids)
+	{
+		const auto stats = host.get_stats(id);
+		frames += stats.frames;
+		deadlines_missed += stats.deadlines_missed;
+		frames_skipped += stats.frames_skipped;
+	}
+
+	const duration<double, std::milli> worst = nanoseconds{ worst_lateness.load() };
+	cout << num_sessions << " sessions on " << num_workers << " workers for " << num_seconds << " s\n"
+		<< frames << " frames of " << num_sessions * num_seconds * SCREEN_REFRESHES_PER_SECOND << " expected\n"
+		<< deadlines_missed << " missed their deadline, worst by " << worst.count() << " ms\n"
+		<< frames_skipped << " skipped\n";
+}
\ No newline at end of file